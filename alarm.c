@@ -0,0 +1,133 @@
+#include <stdint.h>  // `uint8_t` and `uint16_t`
+
+#include "hal.h"     // AVR Mega88 PA (or its simulation)
+#include "pins.h"
+#include "sched.h"
+#include "rtc.h"
+#include "alarm.h"
+
+
+#define ALARM_TAG_ON       0x01   // In the date bits of the alarm 2, which the RTC ignores in the daily mode
+#define ALARM_NEVER        0xFFFF // Minute of the day which never comes
+
+uint8_t      alarmHour     = ALARM_OFF;
+uint8_t      alarmMinute   = 0;
+bit          alarmRinging  = 0;
+bit          alarmLoaded   = 0;            // The setting was taken from the RTC's registers
+uint16_t     alarmSnoozeAt = ALARM_NEVER;  // Minute of the day of the snooze
+uint16_t     alarmLast     = ALARM_NEVER;  // Minute of the day already checked, each minute rings once
+uint8_t      alarmArmed    = 0;            // What the alarmSleep armed
+uint8_t      alarmStep     = 0;            // Index into the alarmPattern
+uint16_t     alarmCycles   = 0;            // Whole patterns since it started ringing
+
+// Vibrate, pause, vibrate, long pause, in the ALARM_PATTERN_MS units. Even steps vibrate,
+// so the pattern always ends with a pause.
+#define ALARM_PATTERN_STEPS  4
+#define ALARM_PATTERN_UNITS  (3 + 2 + 3 + 8)
+flash uint8_t alarmPattern[ALARM_PATTERN_STEPS] = { 3, 2, 3, 8 };
+
+#if ALARM_PATTERN_STEPS & 1
+#error "The alarmPattern has to end with a pause, the motor toggles at each step"
+#endif
+
+
+void alarmMotor(uint8_t on) {
+  if (on) pinHigh(PIN_MOTOR);
+  else    pinLow(PIN_MOTOR);
+}
+
+
+// The first burst read after the reset has the alarm 2 registers
+void alarmLoad(void) {
+  alarmLoaded = 1;
+  if (!(rtcRegisters[RTC_ALARM2 + 2] & ALARM_TAG_ON)) return;
+  alarmMinute = rtcFromBcd(rtcRegisters[RTC_ALARM2]     & 0x7F);
+  alarmHour   = rtcFromBcd(rtcRegisters[RTC_ALARM2 + 1] & 0x3F);
+  if (alarmHour >= ALARM_OFF || alarmMinute >= 60) alarmHour = ALARM_OFF;  // Garbage after the RTC lost its supply
+}
+
+
+void alarmSet(void) {
+  uint8_t on = (alarmHour < ALARM_OFF);
+
+  rtcSetAlarm2(on ? alarmHour : 0, alarmMinute, on ? ALARM_TAG_ON : 0);
+  alarmLoaded = 1;
+}
+
+
+void alarmCheck(uint8_t hour, uint8_t minute) {
+  uint16_t now = hour * 60 + minute;
+
+  if (!alarmLoaded) alarmLoad();
+  if (now == alarmLast) return;
+  alarmLast = now;
+
+  if (now == alarmSnoozeAt) {
+    alarmSnoozeAt = ALARM_NEVER;
+    alarmRing();
+  }
+  if (alarmHour < ALARM_OFF && now == alarmHour * 60 + alarmMinute) alarmRing();
+}
+
+
+void alarmRing(void) {
+  if (alarmRinging) return;
+  alarmRinging = 1;
+  alarmStep    = 0;
+  alarmCycles  = 0;
+  alarmMotor(1);
+  schedAfter(SCHED_ALARM, SCHED_MS(alarmPattern[0] * ALARM_PATTERN_MS));
+}
+
+
+void alarmStop(void) {
+  alarmRinging = 0;
+  alarmMotor(0);
+  schedCancel(SCHED_ALARM);
+}
+
+
+// The snooze is counted from now, not from the alarm's minute, so a late reaction still gets the whole snooze
+void alarmSnooze(void) {
+  uint16_t at = (alarmLast + ALARM_SNOOZE_MIN) % (24 * 60);
+
+  alarmStop();
+  alarmSnoozeAt = at;
+  rtcSetAlarm1(at / 60, at % 60);
+}
+
+
+void alarmDismiss(void) {
+  alarmStop();
+  alarmSnoozeAt = ALARM_NEVER;
+}
+
+
+uint8_t alarmSleep(void) {
+  alarmArmed = 0;
+  if (alarmHour < ALARM_OFF)        alarmArmed |= RTC_A2IE;
+  if (ALARM_NEVER != alarmSnoozeAt) alarmArmed |= RTC_A1IE;
+  return alarmArmed;
+}
+
+
+// An armed alarm holds the ~INT low until its flag is cleared by the clockWake()
+uint8_t alarmWoke(void) {
+  return alarmArmed && !pinRead(PIN_RTC_SQW);
+}
+
+
+uint8_t alarmHandler(void) {
+  if (!schedTake(SCHED_ALARM)) return ALARM_QUIET;
+
+  if (++alarmStep >= ALARM_PATTERN_STEPS) {
+    alarmStep = 0;
+    if (++alarmCycles >= ALARM_RING_S * 1000UL / (ALARM_PATTERN_UNITS * ALARM_PATTERN_MS)) {
+      alarmSnooze();
+      return ALARM_GAVE_UP;
+    }
+  }
+  alarmMotor(!(alarmStep & 1));                  // Even steps vibrate
+  schedAfter(SCHED_ALARM, SCHED_MS(alarmPattern[alarmStep] * ALARM_PATTERN_MS));
+  return ALARM_RINGING;
+}
@@ -0,0 +1,39 @@
+#ifndef SMARTWATCH_ALARM_H
+#define SMARTWATCH_ALARM_H
+
+#include <stdint.h> // `uint8_t` and `uint16_t`
+
+// Daily alarm with a vibration motor. The alarm is the DS3231's alarm 2, the snooze is its
+// alarm 1. While sleeping the ~INT/SQW pin is switched to the alarm interrupt, so waiting for
+// the alarm costs only the RTC's standby current and the MCU stays in the power-down until it
+// rings. While awake the minutes counted from the square wave are compared instead.
+//
+// The setting lives in the RTC's alarm 2 registers (kept on its backup supply) and is read
+// with the first burst read after the reset.
+
+#define ALARM_OFF          24    // alarmHour value of a disabled alarm, the 'set alarm' cycles 0-23 and off
+#define ALARM_SNOOZE_MIN   5     // A click while ringing snoozes for this long, holding the button dismisses
+#define ALARM_RING_S       60    // Nobody reacted, snooze instead of draining the battery
+#define ALARM_PATTERN_MS   100   // Unit of the alarmPattern
+
+// alarmHandler results
+#define ALARM_QUIET        0
+#define ALARM_RINGING      1     // The next step of the pattern, keep awake
+#define ALARM_GAVE_UP      2     // Nobody reacted for the ALARM_RING_S, it's snoozed now
+
+
+extern uint8_t      alarmHour;                // ALARM_OFF or 0-23, changed by the 'set alarm' states
+extern uint8_t      alarmMinute;
+extern bit          alarmRinging;
+
+
+extern void    alarmSet(void);                 // Save the alarmHour and alarmMinute into the RTC
+extern void    alarmCheck(uint8_t hour, uint8_t minute); // The time while awake, rings at the alarm's (or the snooze's) minute
+extern void    alarmRing(void);
+extern void    alarmSnooze(void);              // Stop ringing, ring again in ALARM_SNOOZE_MIN
+extern void    alarmDismiss(void);             // Stop ringing until the next day
+extern uint8_t alarmSleep(void);               // Which alarms have to wake the power-down up (RTC_A1IE/RTC_A2IE)
+extern uint8_t alarmWoke(void);                // The alarm woke the CPU up, call before the clockWake()
+extern uint8_t alarmHandler(void);             // Called from the super loop, steps the vibration pattern on the SCHED_ALARM
+
+#endif
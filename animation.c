@@ -0,0 +1,192 @@
+#include <stdint.h>  // `uint8_t` and `uint16_t`
+
+#include "hal.h"     // AVR Mega88 PA (or its simulation)
+#include "animation.h"
+#include "neopixel.h"
+#include "sched.h"
+#include "profile.h"
+
+
+#define ANIMATION_RED   70   // Perceived brightness of the clock's red, 14 after the gamma (same as the old 0x0F)
+#define ANIMATION_PULSE 90   // Bright and dim half of the 'set time' pulses
+#define ANIMATION_DIM   40
+#define ANIMATION_WHITE 160  // Each channel of the alarm's white, it has to be noticed
+
+#define ANIMATION_END(what) { 0, 0, 0, 0, what }
+
+flash animationKey animationOffKeys[] = {
+  { 0, 0, 0,                            1,  ANIMATION_STEP },
+  ANIMATION_END(ANIMATION_HOLD)
+};
+
+flash animationKey animationPowerUpKeys[] = {
+  { ANIMATION_RED, 0, 0,                10, ANIMATION_EASE },
+  ANIMATION_END(ANIMATION_HOLD)
+};
+
+flash animationKey animationClockKeys[] = {
+  { ANIMATION_RED, 0, 0,                6,  ANIMATION_EASE },
+  ANIMATION_END(ANIMATION_HOLD)
+};
+
+flash animationKey animationPowerDownKeys[] = {
+  { 0, 0, 0,                            ANIMATION_POWER_DOWN_TICKS, ANIMATION_EASE },
+  ANIMATION_END(ANIMATION_HOLD)
+};
+
+flash animationKey animationSetHoursKeys[] = {
+  { 0, ANIMATION_PULSE, 0,              8,  ANIMATION_EASE },
+  { 0, ANIMATION_DIM,   0,              8,  ANIMATION_EASE },
+  ANIMATION_END(ANIMATION_LOOP)
+};
+
+flash animationKey animationSetMinutesKeys[] = {
+  { 0, 0, ANIMATION_PULSE,              8,  ANIMATION_EASE },
+  { 0, 0, ANIMATION_DIM,                8,  ANIMATION_EASE },
+  ANIMATION_END(ANIMATION_LOOP)
+};
+
+flash animationKey animationLowBatteryKeys[] = {
+  { ANIMATION_RED, 0, 0,                1,  ANIMATION_STEP },  // Short red blink once a second
+  { 0, 0, 0,                            4,  ANIMATION_STEP },
+  { ANIMATION_RED, 0, 0,                16, ANIMATION_STEP },
+  ANIMATION_END(ANIMATION_LOOP)
+};
+
+flash animationKey animationAlarmKeys[] = {
+  { ANIMATION_WHITE, ANIMATION_WHITE, ANIMATION_WHITE, 4, ANIMATION_EASE },  // White flashes, 2.5 per second
+  { 0, 0, 0,                            4,  ANIMATION_EASE },
+  ANIMATION_END(ANIMATION_LOOP)
+};
+
+// Indexed by the ANIMATION_OFF..ANIMATION_ALARM
+flash animationKey * flash animationSequences[] = {
+  animationOffKeys,
+  animationPowerUpKeys,
+  animationClockKeys,
+  animationPowerDownKeys,
+  animationSetHoursKeys,
+  animationSetMinutesKeys,
+  animationLowBatteryKeys,
+  animationAlarmKeys
+};
+
+
+// Gamma 2.2, perceived brightness (the top 6 bits of it) to the WS2812B PWM value
+flash uint8_t animationGamma[64] = {
+    0,   0,   0,   0,   1,   1,   1,   2,   3,   4,   4,   5,   7,   8,   9,  11,
+   13,  14,  16,  18,  20,  23,  25,  28,  31,  33,  36,  40,  43,  46,  50,  54,
+   57,  61,  66,  70,  74,  79,  84,  89,  94,  99, 105, 110, 116, 122, 128, 134,
+  140, 147, 153, 160, 167, 174, 182, 189, 197, 205, 213, 221, 229, 238, 246, 255
+};
+
+// Smoothstep 3t^2 - 2t^3 in 16 steps, scaled to 0-255 (the last step is the target itself)
+flash uint8_t animationEase[16] = {
+  0, 3, 11, 24, 40, 59, 81, 104, 128, 151, 174, 196, 215, 231, 244, 252
+};
+
+
+uint8_t              animationSequence = ANIMATION_OFF;
+flash animationKey  *animationKeyNow   = animationOffKeys;  // Keyframe being played
+uint8_t              animationTick     = 0;                 // Frames into the current keyframe
+uint8_t              animationFrom[3]  = { 0, 0, 0 };       // Colour at the start of the keyframe
+uint8_t              animationNow[3]   = { 0, 0, 0 };       // Current colour (perceived brightness)
+uint8_t              animationSent[3]  = { 0, 0, 0 };       // What the LEDs display (after the gamma)
+uint8_t              animationDim      = 0;                 // Perceived brightness is halved this many times
+
+
+// Start the `key` from wherever the colour currently is
+void animationStartKey(flash animationKey *key) {
+  animationFrom[0] = animationNow[0];
+  animationFrom[1] = animationNow[1];
+  animationFrom[2] = animationNow[2];
+  animationTick    = 0;
+  animationKeyNow  = key;
+}
+
+
+void animationPlay(uint8_t sequence) {
+  animationSequence = sequence;
+  animationStartKey(animationSequences[sequence]);
+  schedAfter(SCHED_ANIMATION, SCHED_MS(ANIMATION_FRAME_MS));
+}
+
+
+uint8_t animationPlaying(void) {
+  return animationSequence;
+}
+
+
+// Move one channel from the `from` towards the `to` by the `weight` (0-255)
+uint8_t animationBlend(uint8_t from, uint8_t to, uint8_t weight) {
+  if (to >= from) return from + (uint8_t)(((uint16_t)(to - from) * weight) >> 8);
+  return from - (uint8_t)(((uint16_t)(from - to) * weight) >> 8);
+}
+
+
+// Advance the current keyframe by one frame
+void animationStep(void) {
+  flash animationKey *key = animationKeyNow;
+  uint8_t             weight;
+
+  if (0 == key->ticks) return;             // Holding the last colour
+
+  animationTick++;
+  if (animationTick >= key->ticks) {
+    animationNow[0] = key->red;
+    animationNow[1] = key->green;
+    animationNow[2] = key->blue;
+    key++;
+    if (0 == key->ticks && ANIMATION_LOOP == key->curve) key = animationSequences[animationSequence];
+    animationStartKey(key);
+    return;
+  }
+
+  switch (key->curve) {
+    case ANIMATION_STEP:   return;
+    case ANIMATION_LINEAR: weight = ((uint16_t)animationTick << 8) / key->ticks; break;
+    default:               weight = animationEase[(animationTick << 4) / key->ticks]; break;
+  }
+  animationNow[0] = animationBlend(animationFrom[0], key->red,   weight);
+  animationNow[1] = animationBlend(animationFrom[1], key->green, weight);
+  animationNow[2] = animationBlend(animationFrom[2], key->blue,  weight);
+}
+
+
+// Send to the LEDs only when the gamma corrected colour really changed, every
+// send is a few microseconds with the IRQs disabled. The dimming is applied to the perceived
+// brightness, one halving there is ~1/5 of the LED current after the gamma
+void animationShow(void) {
+  uint8_t red   = animationGamma[(animationNow[0] >> animationDim) >> 2];
+  uint8_t green = animationGamma[(animationNow[1] >> animationDim) >> 2];
+  uint8_t blue  = animationGamma[(animationNow[2] >> animationDim) >> 2];
+
+  if (red == animationSent[0] && green == animationSent[1] && blue == animationSent[2]) return;
+  animationSent[0] = red;
+  animationSent[1] = green;
+  animationSent[2] = blue;
+  neopixelSetColor(((uint32_t)red << 16) | ((uint16_t)green << 8) | blue);
+}
+
+
+void animationOff(void) {
+  animationPlay(ANIMATION_OFF);
+  schedCancel(SCHED_ANIMATION);
+  animationNow[0] = 0;
+  animationNow[1] = 0;
+  animationNow[2] = 0;
+  animationShow();
+}
+
+
+void animationHandler(void) {
+  if (!schedTake(SCHED_ANIMATION)) return;
+
+  profileBegin(PROFILE_ANIMATION);
+  animationStep();
+  animationShow();
+
+  // Holding the last colour doesn't need any frames until the next animationPlay()
+  if (animationKeyNow->ticks) schedAfter(SCHED_ANIMATION, SCHED_MS(ANIMATION_FRAME_MS));
+  profileEnd(PROFILE_ANIMATION);
+}
@@ -0,0 +1,50 @@
+#ifndef SMARTWATCH_ANIMATION_H
+#define SMARTWATCH_ANIMATION_H
+
+#include <stdint.h> // `uint8_t` and `uint16_t`
+
+// Keyframe animations of the Neopixel, played in 50ms frames scheduled only while the colour
+// is moving. Each keyframe moves the colour from wherever it currently is to its target in `ticks` frames along
+// an easing curve. The colours are perceived brightness, the gamma table turns them
+// into the WS2812B PWM values, and the LEDs are sent to only when those change.
+
+// Easing curves
+#define ANIMATION_LINEAR        0
+#define ANIMATION_EASE          1  // Ease-in-out (smoothstep)
+#define ANIMATION_STEP          2  // Keep the previous colour and jump at the end
+
+// What happens after the last keyframe (stored in the `curve` of the terminating keyframe)
+#define ANIMATION_HOLD          0  // Stay on the last colour
+#define ANIMATION_LOOP          1  // Start again from the first keyframe
+
+// Sequences, indexes into the animationSequences table
+#define ANIMATION_OFF           0
+#define ANIMATION_POWER_UP      1
+#define ANIMATION_CLOCK         2
+#define ANIMATION_POWER_DOWN    3
+#define ANIMATION_SET_HOURS     4
+#define ANIMATION_SET_MINUTES   5
+#define ANIMATION_LOW_BATTERY   6
+#define ANIMATION_ALARM         7
+
+#define ANIMATION_FRAME_MS      50 // One frame of the animation
+#define ANIMATION_POWER_DOWN_TICKS 16 // The power-down fade takes the last 16 frames before the sleep
+
+
+typedef struct {
+  uint8_t red, green, blue;  // Target colour, perceived brightness
+  uint8_t ticks;             // Frames to reach it, 0 terminates the sequence
+  uint8_t curve;             // ANIMATION_LINEAR..STEP (or ANIMATION_HOLD/LOOP for the terminator)
+} animationKey;
+
+
+
+extern uint8_t animationDim;                    // 0 full brightness, each step halves the perceived brightness
+
+
+extern void    animationPlay(uint8_t sequence); // Start a sequence from the current colour
+extern void    animationOff(void);              // Black right now, before going to sleep
+extern uint8_t animationPlaying(void);          // Which sequence was started last
+extern void    animationHandler(void);          // Called from the super loop, advances on the SCHED_ANIMATION
+
+#endif
@@ -0,0 +1,90 @@
+#include <stdint.h>  // `uint8_t` and `uint16_t`
+
+#include "hal.h"     // AVR Mega88 PA (or its simulation)
+#include "sched.h"
+#include "vfd.h"
+#include "animation.h"
+#include "clock.h"
+#include "battery.h"
+#include "power.h"
+
+
+// AVCC as the reference, the 1.1V bandgap as the input
+#define BATTERY_ADMUX   ((0 << REFS1) | (1 << REFS0) | (0 << ADLAR) | 0x0E)
+
+// 125kHz ADC clock (F_CPU/64), one conversion is 13 ADC clocks, the first after enabling it 25
+#define BATTERY_ADCSRA  ((1 << ADEN) | (1 << ADSC) | (1 << ADIE) | (1 << ADPS2) | (1 << ADPS1) | (0 << ADPS0))
+
+#if HAL_F_CPU / 64 > 200000 || HAL_F_CPU / 64 < 50000
+#error "The ADC needs a 50kHz to 200kHz clock for the full resolution, change the ADPS bits"
+#endif
+
+
+uint16_t          batteryMillivolts = 0;
+uint8_t           batteryLevel      = BATTERY_OK;
+volatile uint8_t  batteryConversions;
+volatile uint16_t batterySum;
+
+// What each level allows: VFD brightness limit, Neopixel dimming (right shift of the perceived brightness)
+flash uint8_t     batteryVfdLimit[3] = { VFD_BRIGHTNESS_LEVELS - 1, 2, VFD_NIGHT_LEVEL };
+flash uint8_t     batteryDim[3]      = { 0, 1, 2 };
+
+
+void batteryMeasure(void) {
+  batteryConversions = 0;
+  batterySum         = 0;
+  powerAcquire(POWER_ADC);                        // The ADC is clocked only while measuring
+  ADMUX              = BATTERY_ADMUX;
+  ADCSRA             = BATTERY_ADCSRA;
+}
+
+
+// ADC conversion complete interrupt service routine
+HAL_ISR(ADC_INT) void adc_isr(void) {
+  // The first conversion is thrown away, the bandgap is still settling after being selected
+  if (batteryConversions++) batterySum += ADCW;
+
+  if (batteryConversions <= BATTERY_SAMPLES) {
+    ADCSRA |= (1 << ADSC);                        // Next conversion
+    return;
+  }
+  ADCSRA  = 0;                                    // ADC off and its clock gated
+  powerRelease(POWER_ADC);
+  schedPost(SCHED_BATTERY);
+}
+
+
+uint8_t batteryHandler(void) {
+  uint16_t millivolts;
+  uint8_t  level;
+
+  if (!schedTake(SCHED_BATTERY)) return 0;
+  if (!batterySum) return 0;                      // Can't happen with a working ADC, but never divide by 0
+
+  // VCC = 1.1V * 1024 / ADC, the sum has BATTERY_SAMPLES of them
+  millivolts = (uint32_t)BATTERY_BANDGAP_MV * 1024 * BATTERY_SAMPLES / batterySum;
+
+  // One measurement per wake-up is noisy (the VFD's DC2DC just started), a slow average follows the trend
+  if (batteryMillivolts) millivolts = ((uint32_t)batteryMillivolts * 3 + millivolts) / 4;
+  batteryMillivolts = millivolts;
+
+  level = BATTERY_OK;
+  if (millivolts < BATTERY_LOW_MV      + ((batteryLevel >= BATTERY_LOW)      ? BATTERY_HYSTERESIS_MV : 0)) level = BATTERY_LOW;
+  if (millivolts < BATTERY_CRITICAL_MV + ((batteryLevel >= BATTERY_CRITICAL) ? BATTERY_HYSTERESIS_MV : 0)) level = BATTERY_CRITICAL;
+
+  if (level != batteryLevel) {
+    batteryLevel  = level;
+    vfdLimit      = batteryVfdLimit[level];
+    animationDim  = batteryDim[level];
+    vfdBrightnessForHour(clockHour);              // Apply the new limit right away
+  }
+  return 1;
+}
+
+
+// 100% of the timeout with a good battery, 75% when low and 50% when critical
+uint32_t batteryTimeout(uint32_t ms) {
+  if      (BATTERY_CRITICAL == batteryLevel) ms = ms / 2;
+  else if (BATTERY_LOW      == batteryLevel) ms = ms - ms / 4;
+  return (ms < BATTERY_MIN_TIMEOUT_MS) ? BATTERY_MIN_TIMEOUT_MS : ms;
+}
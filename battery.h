@@ -0,0 +1,32 @@
+#ifndef SMARTWATCH_BATTERY_H
+#define SMARTWATCH_BATTERY_H
+
+#include <stdint.h> // `uint8_t` and `uint16_t`
+
+// Battery (VCC) monitor. The ADC measures the internal 1.1V bandgap against the AVCC, the
+// lower the VCC the bigger the result. It's measured once per wake-up, the ADC is clocked
+// only for the ~0.6ms of the conversions. The filtered voltage selects a level and the
+// level limits how much the watch consumes, so it runs longer instead of browning out.
+
+#define BATTERY_BANDGAP_MV     1100  // Nominal, the chips vary between 1.0V and 1.2V (calibrate for exact levels)
+#define BATTERY_SAMPLES        4     // Conversions averaged after the first one is thrown away
+#define BATTERY_LOW_MV         3600  // Below this the awake time, VFD and Neopixel are reduced
+#define BATTERY_CRITICAL_MV    3400  // Below this the watch is barely usable, the Neopixel blinks red
+#define BATTERY_HYSTERESIS_MV  50    // To go back up a level the voltage has to be this much above it
+#define BATTERY_MIN_TIMEOUT_MS 4000  // The shortened awake timeout never goes below this
+
+// Levels
+#define BATTERY_OK             0
+#define BATTERY_LOW            1
+#define BATTERY_CRITICAL       2
+
+
+extern uint16_t batteryMillivolts;             // Filtered VCC, 0 until the first measurement
+extern uint8_t  batteryLevel;                  // BATTERY_OK..BATTERY_CRITICAL
+
+
+extern void     batteryMeasure(void);           // Clock the ADC and start the conversions, SCHED_BATTERY is posted at the end
+extern uint8_t  batteryHandler(void);           // Called from the super loop, returns 1 when a measurement was applied
+extern uint32_t batteryTimeout(uint32_t ms);   // The awake timeout shortened by the battery level
+
+#endif
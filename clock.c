@@ -0,0 +1,126 @@
+#include <stdint.h>  // `uint8_t` and `uint16_t` 
+
+#include "hal.h"     // AVR Mega88 PA and DS3231 over TWI(I2C) (or their simulation)
+#include "pins.h"
+#include "rtc.h"
+#include "clock.h"
+#include "sched.h"
+#include "thermal.h"
+
+
+uint8_t               clockHour    = 8;  // On power up start with 8:00 time
+uint8_t               clockMinute  = 0;
+uint8_t               clockSecond  = 0;
+volatile bit          clockColon   = 0;
+volatile uint8_t      clockPending = 0;  // Falling edges (seconds) counted by the IRQ, not applied yet
+bit                   clockSyncing = 0;  // Waiting for the RTC burst read, the time is not known yet
+bit                   clockAlarms  = 0;  // The ~INT/SQW is the alarm interrupt while sleeping
+
+
+
+// Called by the pin change IRQ with the current ~INT/SQW level, the IRQ
+// is shared with the WAKE-UP button so the level might not have changed at all
+void clockSqwSample(uint8_t level) {
+  if (level == clockColon) return;
+  clockColon = level;
+  if (!level) clockPending++;            // The seconds register increments on the falling edge
+  schedPost(SCHED_SECOND);               // Both edges, the ':' blinks
+}
+
+
+// Apply the seconds counted by the IRQ, the carry to the minutes and hours
+// is done here in the super loop, so the IRQ stays short and the time
+// is never displayed half-updated. Returns 0 while the time is not known yet.
+uint8_t clockUpdate(void) {
+  uint8_t seconds;
+
+  if (clockSyncing) {
+    if (!rtcReady()) return 0;           // The TWI IRQ is still reading the registers
+    clockSyncing = 0;
+    thermalApply(rtcTemperature());      // The burst has the temperature too, once per wake-up
+    if (rtcTimeLost()) {
+      // The RTC's oscillator stopped, the time the watch had before is better than its garbage
+      clockSet(clockHour, clockMinute, 0);
+      return 1;
+    }
+    rtcGetTime(&clockHour, &clockMinute, &clockSecond);
+  }
+
+  // Take the count and zero it with the IRQs disabled, the decrement is a load and a store
+  // and an edge counted between them would be lost
+  halInterruptsDisable();
+  seconds      = clockPending;
+  clockPending = 0;
+  halInterruptsEnable();
+
+  for (; seconds; seconds--) {
+    if (++clockSecond < 60) continue;
+    clockSecond = 0;
+    if (++clockMinute < 60) continue;
+    clockMinute = 0;
+    if (++clockHour   < 24) continue;
+    clockHour   = 0;
+  }
+  return 1;
+}
+
+
+// Writing the seconds register restarts the RTC's countdown chain, 
+// so the square wave is aligned with the new time as well
+void clockSet(uint8_t hour, uint8_t minute, uint8_t second) {
+  rtcSetTime(hour, minute, second);
+  clockSyncing = 0;
+  clockPending = 0;
+  clockHour    = hour;
+  clockMinute  = minute;
+  clockSecond  = second;
+}
+
+
+// After the reset the RTC normally kept the time on its own, it's read like after a sleep,
+// the `hour` and `minute` (the last time known before the reset) are used only when it didn't
+void clockStart(uint8_t hour, uint8_t minute) {
+  clockHour   = hour;
+  clockMinute = minute;
+  clockSecond = 0;
+  clockWake();
+}
+
+
+// While sleeping the square wave must not wake up the CPU every second. With the PCINT19
+// masked the PD3 input is clamped during the power-down, so the internal pull-up is disabled
+// as well, otherwise it would be sinking current into the ~INT/SQW every low half-period.
+//
+// With an alarm armed the ~INT/SQW is switched to the alarm interrupt instead. It's released
+// (no current through the pull-up) until the alarm matches and then its falling edge wakes the
+// CPU up, so the RTC does all the waiting. The write clears the old alarm flags as well.
+void clockSleep(uint8_t alarms) {
+  if (alarms) {
+    rtcInit(RTC_INTCN | alarms);
+    rtcWait();                           // The TWI doesn't run in the power-down
+    clockAlarms = 1;
+    return;
+  }
+  PCMSK2 &= ~pinMask(PIN_RTC_SQW);
+  pinLow(PIN_RTC_SQW);
+}
+
+
+// Listen to the square wave again and resync with the RTC as a lot of time could have passed.
+// The burst read is the only TWI transaction during the normal operation, the edges counted
+// after it started are added on top of the time it reads.
+void clockWake(void) {
+  pinHigh(PIN_RTC_SQW);
+  if (clockAlarms) {
+    // Back to the square wave, it starts in the middle of a second, so the edges are
+    // counted only after the switch (which clears the alarm flags and releases the ~INT)
+    clockAlarms = 0;
+    rtcInit(RTC_SQW_1HZ);
+    rtcWait();
+  }
+  clockColon   = pinRead(PIN_RTC_SQW) ? 1 : 0; // Start from the current level, the first edge counts only when it's a real one
+  clockPending = 0;
+  clockSyncing = 1;
+  PCMSK2      |= pinMask(PIN_RTC_SQW);
+  rtcRefresh();
+}
@@ -0,0 +1,24 @@
+#ifndef SMARTWATCH_CLOCK_H
+#define SMARTWATCH_CLOCK_H
+
+#include <stdint.h>     // `uint8_t` and `uint16_t` 
+
+// Timekeeping driven by the DS3231's 1Hz square wave on the ~INT/SQW pin (PD3/PCINT19).
+// The time is kept locally and the RTC is read over the TWI only after waking up,
+// the seconds increment on the falling edge of the square wave, 500ms later
+// it goes high again which is used to blink the ':' in phase with the real seconds.
+
+extern uint8_t      clockHour;
+extern uint8_t      clockMinute;
+extern uint8_t      clockSecond;
+extern volatile bit clockColon;        // High half of the square wave, the ':' should be displayed
+
+
+extern void    clockSqwSample(uint8_t level); // Called by the pin change IRQ with the PD3 level
+extern uint8_t clockUpdate(void);             // Apply the seconds counted by the IRQ, 0 while the RTC is being read
+extern void    clockSet(uint8_t hour, uint8_t minute, uint8_t second);
+extern void    clockStart(uint8_t hour, uint8_t minute); // After the reset, the time is used only if the RTC lost its own
+extern void    clockSleep(uint8_t alarms);    // Stop listening to the square wave before the power-down, RTC_A1IE/RTC_A2IE wake it up
+extern void    clockWake(void);               // Start the RTC burst read and listen to the square wave again
+
+#endif
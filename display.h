@@ -0,0 +1,138 @@
+#ifndef SMARTWATCH_DISPLAY_H
+#define SMARTWATCH_DISPLAY_H
+
+// Description of the tube and of the driver behind it, selected by the DISPLAY at the compile time.
+// Everything else is generated from it by the preprocessor: the ready-to-send words of the font
+// tables (font.c), the grid tables and the slot length of the multiplexer, the number of the SPI
+// bytes per word (vfd.h, vfd.c) and the MAX69xx model of the simulator. Each build contains only
+// the code and the tables of its own tube, the refresh doesn't branch on the layout.
+//
+// A description has:
+//
+//   DISPLAY_DRIVER_BITS    Outputs of the driver, 12 (MAX6920), 20 (MAX6921) or more drivers chained (up to 32)
+//   DISPLAY_GRIDS          Grids refreshed, each gets its own slot of the Timer0
+//   DISPLAY_TEXT_CHARS     Characters of the displayText (and of a UART message)
+//   VFD_A..VFD_G, VFD_DP   Driver outputs of the segments, the decimal point is optional
+//   DISPLAY_CH_*           Driver outputs of the grids which show the time (the glyph tables need them)
+//   DISPLAY_POS_*          Where in the refresh order they are (the hours and the minutes are 2 grids each)
+//   DISPLAY_COLON_SEGMENTS Segments lit on the DISPLAY_CH_COLON grid when the colon is on, 0 = the grid itself glows
+//   DISPLAY_GRID_LIST      DISPLAY_GRID(output, trim, text) of each grid in the refresh order: its driver output,
+//                          its share of the brightness in 1/16ths and which character of a text it shows
+//                          (DISPLAY_NO_TEXT = blank while a text is displayed)
+
+#define DISPLAY_IVL2_7_5_MAX6920  1  // The watch, IVL2-7/5 (HH:MM) behind the 12-bit MAX6920AWP
+#define DISPLAY_IV18_MAX6921      2  // 8 digits (and the symbol grid) of the IV-18 behind the 20-bit MAX6921
+
+#define DISPLAY_NO_TEXT           255
+
+#ifndef DISPLAY
+#define DISPLAY DISPLAY_IVL2_7_5_MAX6920
+#endif
+
+
+#if DISPLAY == DISPLAY_IVL2_7_5_MAX6920
+
+#define DISPLAY_DRIVER_BITS       12
+#define DISPLAY_GRIDS             5    // HH:MM -> 4 digits and the ':' character
+#define DISPLAY_TEXT_CHARS        4
+
+// Individual segments of a 7-segment character
+// https://en.wikipedia.org/wiki/Seven-segment_display
+//  --A--
+// |     |
+// F     B
+// |     |
+//  --G--
+// |     |
+// E     C
+// |     |
+//  --D--
+#define VFD_A                     10
+#define VFD_B                     0
+#define VFD_C                     4
+#define VFD_D                     2
+#define VFD_E                     8
+#define VFD_F                     9
+#define VFD_G                     7
+
+// Character selectors
+#define DISPLAY_CH_HOURS_TENS     6    // Hours major
+#define DISPLAY_CH_HOURS_UNITS    5    // Hours minor
+#define DISPLAY_CH_COLON          3    // The : character between the hours and minutes -> HH:MM
+#define DISPLAY_CH_MINUTES_TENS   1    // Minutes major
+#define DISPLAY_CH_MINUTES_UNITS  11   // Minutes minor
+
+#define DISPLAY_POS_HOURS         0
+#define DISPLAY_POS_COLON         2
+#define DISPLAY_POS_MINUTES       3
+#define DISPLAY_COLON_SEGMENTS    0    // The ':' has no segments
+
+// The ':' is just two dots and looks brighter than the digits with the same on-time
+#define DISPLAY_GRID_LIST \
+  DISPLAY_GRID(DISPLAY_CH_HOURS_TENS,    16, 0)               \
+  DISPLAY_GRID(DISPLAY_CH_HOURS_UNITS,   16, 1)               \
+  DISPLAY_GRID(DISPLAY_CH_COLON,         10, DISPLAY_NO_TEXT) \
+  DISPLAY_GRID(DISPLAY_CH_MINUTES_TENS,  16, 2)               \
+  DISPLAY_GRID(DISPLAY_CH_MINUTES_UNITS, 16, 3)
+
+
+#elif DISPLAY == DISPLAY_IV18_MAX6921
+
+// The segments on the OUT0-7, the digits on the OUT8-15 (left to right) and the symbol grid on the
+// OUT16. The time is "HH-MM" in the middle of the 8 digits, a text uses all of them. The symbol grid
+// stays blank, but keeps its slot.
+#define DISPLAY_DRIVER_BITS       20
+#define DISPLAY_GRIDS             9
+#define DISPLAY_TEXT_CHARS        8
+
+#define VFD_A                     0
+#define VFD_B                     1
+#define VFD_C                     2
+#define VFD_D                     3
+#define VFD_E                     4
+#define VFD_F                     5
+#define VFD_G                     6
+#define VFD_DP                    7
+
+#define DISPLAY_CH_HOURS_TENS     9
+#define DISPLAY_CH_HOURS_UNITS    10
+#define DISPLAY_CH_COLON          11
+#define DISPLAY_CH_MINUTES_TENS   12
+#define DISPLAY_CH_MINUTES_UNITS  13
+
+#define DISPLAY_POS_HOURS         2
+#define DISPLAY_POS_COLON         4
+#define DISPLAY_POS_MINUTES       5
+#define DISPLAY_COLON_SEGMENTS    VFD_BIT(VFD_G)   // No colon on this tube, a '-' instead
+
+#define DISPLAY_GRID_LIST \
+  DISPLAY_GRID(16,                       16, DISPLAY_NO_TEXT) \
+  DISPLAY_GRID(8,                        16, 0)               \
+  DISPLAY_GRID(DISPLAY_CH_HOURS_TENS,    16, 1)               \
+  DISPLAY_GRID(DISPLAY_CH_HOURS_UNITS,   16, 2)               \
+  DISPLAY_GRID(DISPLAY_CH_COLON,         16, 3)               \
+  DISPLAY_GRID(DISPLAY_CH_MINUTES_TENS,  16, 4)               \
+  DISPLAY_GRID(DISPLAY_CH_MINUTES_UNITS, 16, 5)               \
+  DISPLAY_GRID(14,                       16, 6)               \
+  DISPLAY_GRID(15,                       16, 7)
+
+
+#else
+#error "Unknown DISPLAY"
+#endif
+
+
+#if DISPLAY_DRIVER_BITS > 32
+#error "The words of the refresh are at most 32-bit"
+#endif
+
+#if (DISPLAY_DRIVER_BITS + 7) / 8 < 2
+#error "The words of the refresh are at least 2 SPI bytes, the SPI IRQ streams the lower ones"
+#endif
+
+#if DISPLAY_POS_COLON == DISPLAY_POS_HOURS || DISPLAY_POS_COLON == DISPLAY_POS_HOURS + 1 || \
+    DISPLAY_POS_COLON == DISPLAY_POS_MINUTES || DISPLAY_POS_COLON == DISPLAY_POS_MINUTES + 1
+#error "The colon needs a grid of its own, the time commits each grid once"
+#endif
+
+#endif
@@ -0,0 +1,147 @@
+#include <stdint.h>  // `uint8_t` and `uint16_t` 
+
+#include "hal.h"     // `flash` tables (or their simulation)
+#include "font.h"
+#include "vfd.h"
+
+
+// Generators for the 2-digit tables, the `tens` and `units` are pasted into the FONT_DIGIT_x names
+#define FONT_HOURS_TENS_0        0                                    // Leading 0 is not displayed at all
+#define FONT_HOURS_TENS_1        (FONT_DIGIT_1 | VFD_BIT(DISPLAY_CH_HOURS_TENS))
+#define FONT_HOURS_TENS_2        (FONT_DIGIT_2 | VFD_BIT(DISPLAY_CH_HOURS_TENS))
+
+#define FONT_HOURS(tens, units)   { FONT_HOURS_TENS_##tens,                                   \
+                                    FONT_DIGIT_##units | VFD_BIT(DISPLAY_CH_HOURS_UNITS) }
+#define FONT_MINUTES(tens, units) { FONT_DIGIT_##tens  | VFD_BIT(DISPLAY_CH_MINUTES_TENS),    \
+                                    FONT_DIGIT_##units | VFD_BIT(DISPLAY_CH_MINUTES_UNITS) }
+
+#define FONT_DECADE(pair, tens)  pair(tens, 0), pair(tens, 1), pair(tens, 2), pair(tens, 3), pair(tens, 4), \
+                                 pair(tens, 5), pair(tens, 6), pair(tens, 7), pair(tens, 8), pair(tens, 9)
+
+
+flash fontDigitPair fontHours[24] = {
+  FONT_DECADE(FONT_HOURS, 0),
+  FONT_DECADE(FONT_HOURS, 1),
+  FONT_HOURS(2, 0), FONT_HOURS(2, 1), FONT_HOURS(2, 2), FONT_HOURS(2, 3)
+};
+
+
+flash fontDigitPair fontMinutes[60] = {
+  FONT_DECADE(FONT_MINUTES, 0),
+  FONT_DECADE(FONT_MINUTES, 1),
+  FONT_DECADE(FONT_MINUTES, 2),
+  FONT_DECADE(FONT_MINUTES, 3),
+  FONT_DECADE(FONT_MINUTES, 4),
+  FONT_DECADE(FONT_MINUTES, 5)
+};
+
+
+// The 7-segment display is limited, but can 'render' most of the alphanumerical characters,
+// where the uppercase letter is not possible a lowercase shape is used and the other way around
+flash vfdWord fontAscii[FONT_CHARS] = {
+  0,                                                                        // ' '
+  FONT_SEG(B) | FONT_SEG(C),                                                // '!'
+  FONT_SEG(B) | FONT_SEG(F),                                                // '"'
+  0,                                                                        // '#'
+  FONT_DIGIT_5,                                                             // '$'
+  0,                                                                        // '%'
+  0,                                                                        // '&'
+  FONT_SEG(B),                                                              // '''
+  FONT_SEG(A) | FONT_SEG(D) | FONT_SEG(E) | FONT_SEG(F),                    // '('
+  FONT_SEG(A) | FONT_SEG(B) | FONT_SEG(C) | FONT_SEG(D),                    // ')'
+  0,                                                                        // '*'
+  0,                                                                        // '+'
+  FONT_SEG(C),                                                              // ','
+  FONT_SEG(G),                                                              // '-'
+  FONT_DOT,                                                                 // '.'
+  FONT_SEG(B) | FONT_SEG(E) | FONT_SEG(G),                                  // '/'
+  FONT_DIGIT_0,                                                             // '0'
+  FONT_DIGIT_1,                                                             // '1'
+  FONT_DIGIT_2,                                                             // '2'
+  FONT_DIGIT_3,                                                             // '3'
+  FONT_DIGIT_4,                                                             // '4'
+  FONT_DIGIT_5,                                                             // '5'
+  FONT_DIGIT_6,                                                             // '6'
+  FONT_DIGIT_7,                                                             // '7'
+  FONT_DIGIT_8,                                                             // '8'
+  FONT_DIGIT_9,                                                             // '9'
+  0,                                                                        // ':' is a separate character on the VFD
+  0,                                                                        // ';'
+  FONT_SEG(D) | FONT_SEG(E) | FONT_SEG(G),                                  // '<'
+  FONT_SEG(D) | FONT_SEG(G),                                                // '='
+  FONT_SEG(C) | FONT_SEG(D) | FONT_SEG(G),                                  // '>'
+  FONT_SEG(A) | FONT_SEG(B) | FONT_SEG(E) | FONT_SEG(G),                    // '?'
+  FONT_DIGIT_8 & ~FONT_SEG(F),                                              // '@'
+  FONT_DIGIT_8 & ~FONT_SEG(D),                                              // 'A'
+  FONT_SEG(C) | FONT_SEG(D) | FONT_SEG(E) | FONT_SEG(F) | FONT_SEG(G),      // 'B' as 'b'
+  FONT_SEG(A) | FONT_SEG(D) | FONT_SEG(E) | FONT_SEG(F),                    // 'C'
+  FONT_SEG(B) | FONT_SEG(C) | FONT_SEG(D) | FONT_SEG(E) | FONT_SEG(G),      // 'D' as 'd'
+  FONT_SEG(A) | FONT_SEG(D) | FONT_SEG(E) | FONT_SEG(F) | FONT_SEG(G),      // 'E'
+  FONT_SEG(A) | FONT_SEG(E) | FONT_SEG(F) | FONT_SEG(G),                    // 'F'
+  FONT_SEG(A) | FONT_SEG(C) | FONT_SEG(D) | FONT_SEG(E) | FONT_SEG(F),      // 'G'
+  FONT_SEG(B) | FONT_SEG(C) | FONT_SEG(E) | FONT_SEG(F) | FONT_SEG(G),      // 'H'
+  FONT_SEG(E) | FONT_SEG(F),                                                // 'I'
+  FONT_SEG(B) | FONT_SEG(C) | FONT_SEG(D) | FONT_SEG(E),                    // 'J'
+  FONT_SEG(A) | FONT_SEG(C) | FONT_SEG(E) | FONT_SEG(F) | FONT_SEG(G),      // 'K' approximation
+  FONT_SEG(D) | FONT_SEG(E) | FONT_SEG(F),                                  // 'L'
+  FONT_SEG(A) | FONT_SEG(C) | FONT_SEG(E),                                  // 'M' approximation
+  FONT_SEG(A) | FONT_SEG(B) | FONT_SEG(C) | FONT_SEG(E) | FONT_SEG(F),      // 'N'
+  FONT_DIGIT_0,                                                             // 'O'
+  FONT_SEG(A) | FONT_SEG(B) | FONT_SEG(E) | FONT_SEG(F) | FONT_SEG(G),      // 'P'
+  FONT_SEG(A) | FONT_SEG(B) | FONT_SEG(C) | FONT_SEG(F) | FONT_SEG(G),      // 'Q' as 'q'
+  FONT_SEG(E) | FONT_SEG(G),                                                // 'R' as 'r'
+  FONT_DIGIT_5,                                                             // 'S'
+  FONT_SEG(D) | FONT_SEG(E) | FONT_SEG(F) | FONT_SEG(G),                    // 'T' as 't'
+  FONT_SEG(B) | FONT_SEG(C) | FONT_SEG(D) | FONT_SEG(E) | FONT_SEG(F),      // 'U'
+  FONT_SEG(C) | FONT_SEG(D) | FONT_SEG(E),                                  // 'V' as 'u'
+  FONT_SEG(B) | FONT_SEG(D) | FONT_SEG(F),                                  // 'W' approximation
+  FONT_SEG(B) | FONT_SEG(C) | FONT_SEG(E) | FONT_SEG(F) | FONT_SEG(G),      // 'X' as 'H'
+  FONT_SEG(B) | FONT_SEG(C) | FONT_SEG(D) | FONT_SEG(F) | FONT_SEG(G),      // 'Y'
+  FONT_DIGIT_2,                                                             // 'Z'
+  FONT_SEG(A) | FONT_SEG(D) | FONT_SEG(E) | FONT_SEG(F),                    // '['
+  FONT_SEG(C) | FONT_SEG(F) | FONT_SEG(G),                                  // '\'
+  FONT_SEG(A) | FONT_SEG(B) | FONT_SEG(C) | FONT_SEG(D),                    // ']'
+  FONT_SEG(A) | FONT_SEG(B) | FONT_SEG(F),                                  // '^'
+  FONT_SEG(D),                                                              // '_'
+  FONT_SEG(F),                                                              // '`'
+  FONT_DIGIT_8 & ~FONT_SEG(D),                                              // 'a' as 'A'
+  FONT_SEG(C) | FONT_SEG(D) | FONT_SEG(E) | FONT_SEG(F) | FONT_SEG(G),      // 'b'
+  FONT_SEG(D) | FONT_SEG(E) | FONT_SEG(G),                                  // 'c'
+  FONT_SEG(B) | FONT_SEG(C) | FONT_SEG(D) | FONT_SEG(E) | FONT_SEG(G),      // 'd'
+  FONT_SEG(A) | FONT_SEG(D) | FONT_SEG(E) | FONT_SEG(F) | FONT_SEG(G),      // 'e' as 'E'
+  FONT_SEG(A) | FONT_SEG(E) | FONT_SEG(F) | FONT_SEG(G),                    // 'f' as 'F'
+  FONT_DIGIT_9 | FONT_SEG(D),                                               // 'g'
+  FONT_SEG(C) | FONT_SEG(E) | FONT_SEG(F) | FONT_SEG(G),                    // 'h'
+  FONT_SEG(E),                                                              // 'i'
+  FONT_SEG(B) | FONT_SEG(C) | FONT_SEG(D),                                  // 'j'
+  FONT_SEG(A) | FONT_SEG(C) | FONT_SEG(E) | FONT_SEG(F) | FONT_SEG(G),      // 'k' approximation
+  FONT_SEG(E) | FONT_SEG(F),                                                // 'l'
+  FONT_SEG(A) | FONT_SEG(C) | FONT_SEG(E),                                  // 'm' approximation
+  FONT_SEG(C) | FONT_SEG(E) | FONT_SEG(G),                                  // 'n'
+  FONT_SEG(C) | FONT_SEG(D) | FONT_SEG(E) | FONT_SEG(G),                    // 'o'
+  FONT_SEG(A) | FONT_SEG(B) | FONT_SEG(E) | FONT_SEG(F) | FONT_SEG(G),      // 'p' as 'P'
+  FONT_SEG(A) | FONT_SEG(B) | FONT_SEG(C) | FONT_SEG(F) | FONT_SEG(G),      // 'q'
+  FONT_SEG(E) | FONT_SEG(G),                                                // 'r'
+  FONT_DIGIT_5,                                                             // 's' as 'S'
+  FONT_SEG(D) | FONT_SEG(E) | FONT_SEG(F) | FONT_SEG(G),                    // 't'
+  FONT_SEG(C) | FONT_SEG(D) | FONT_SEG(E),                                  // 'u'
+  FONT_SEG(C) | FONT_SEG(D) | FONT_SEG(E),                                  // 'v' as 'u'
+  FONT_SEG(B) | FONT_SEG(D) | FONT_SEG(F),                                  // 'w' approximation
+  FONT_SEG(B) | FONT_SEG(C) | FONT_SEG(E) | FONT_SEG(F) | FONT_SEG(G),      // 'x' as 'H'
+  FONT_SEG(B) | FONT_SEG(C) | FONT_SEG(D) | FONT_SEG(F) | FONT_SEG(G),      // 'y'
+  FONT_DIGIT_2,                                                             // 'z' as 'Z'
+  FONT_SEG(A) | FONT_SEG(D) | FONT_SEG(E) | FONT_SEG(F),                    // '{'
+  FONT_SEG(E) | FONT_SEG(F),                                                // '|'
+  FONT_SEG(A) | FONT_SEG(B) | FONT_SEG(C) | FONT_SEG(D),                    // '}'
+  FONT_SEG(A),                                                              // '~'
+  0                                                                         // DEL
+};
+
+
+// Segments for any character, unsupported characters are blank
+vfdWord fontGlyph(char character) {
+  uint8_t index = (uint8_t)character - FONT_FIRST_CHAR;
+
+  if (index >= FONT_CHARS) return 0; // Control characters wrap around to big numbers as well
+  return fontAscii[index];
+}
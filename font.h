@@ -0,0 +1,59 @@
+#ifndef SMARTWATCH_FONT_H
+#define SMARTWATCH_FONT_H
+
+#include <stdint.h>     // `uint8_t` and `uint16_t` 
+
+#include "vfd.h"
+
+
+// All glyphs are built by the preprocessor from the VFD_A..VFD_G segment assignment of the
+// display.h, so the tables stay correct even if the VFD gets rewired or replaced. They are placed
+// in the flash and contain ready-to-send driver words, the refresh doesn't compute anything.
+//  --A--
+// |     |
+// F     B
+// |     |
+//  --G--
+// |     |
+// E     C
+// |     |
+//  --D--
+
+#define FONT_SEG(s)   VFD_BIT(VFD_##s)
+
+#define FONT_DIGIT_0  (FONT_SEG(A) | FONT_SEG(B) | FONT_SEG(C) | FONT_SEG(D) | FONT_SEG(E) | FONT_SEG(F))
+#define FONT_DIGIT_1  (FONT_SEG(B) | FONT_SEG(C))
+#define FONT_DIGIT_2  (FONT_SEG(A) | FONT_SEG(B) | FONT_SEG(G) | FONT_SEG(E) | FONT_SEG(D))
+#define FONT_DIGIT_3  (FONT_SEG(A) | FONT_SEG(B) | FONT_SEG(G) | FONT_SEG(C) | FONT_SEG(D))
+#define FONT_DIGIT_4  (FONT_SEG(F) | FONT_SEG(G) | FONT_SEG(B) | FONT_SEG(C))
+#define FONT_DIGIT_5  (FONT_SEG(A) | FONT_SEG(F) | FONT_SEG(G) | FONT_SEG(C) | FONT_SEG(D))
+#define FONT_DIGIT_6  (FONT_SEG(F) | FONT_SEG(G) | FONT_SEG(C) | FONT_SEG(D) | FONT_SEG(E))
+#define FONT_DIGIT_7  (FONT_SEG(A) | FONT_SEG(B) | FONT_SEG(C))
+#define FONT_DIGIT_8  (FONT_SEG(A) | FONT_SEG(B) | FONT_SEG(C) | FONT_SEG(D) | FONT_SEG(E) | FONT_SEG(F) | FONT_SEG(G))
+#define FONT_DIGIT_9  (FONT_SEG(A) | FONT_SEG(F) | FONT_SEG(B) | FONT_SEG(G) | FONT_SEG(C))
+
+#ifdef VFD_DP
+#define FONT_DOT      FONT_SEG(DP)
+#else
+#define FONT_DOT      FONT_SEG(D)   // No decimal point on the tube
+#endif
+
+#define FONT_FIRST_CHAR ' ' // The alphanumeric font covers the printable ASCII 0x20-0x7F
+#define FONT_CHARS      96
+
+
+// Two ready-to-send words for a 2-digit number, the tens character and the units character
+typedef struct {
+  vfdWord major;
+  vfdWord minor;
+} fontDigitPair;
+
+
+extern flash fontDigitPair fontHours[24];            // 0-23 for the DISPLAY_CH_HOURS_*, leading 0 is blank
+extern flash fontDigitPair fontMinutes[60];          // 0-59 for the DISPLAY_CH_MINUTES_*
+extern flash vfdWord       fontAscii[FONT_CHARS];    // Segments (without a character selector) of the ASCII 0x20-0x7F
+
+
+extern vfdWord fontGlyph(char character);           // Segments for any character, unsupported characters are blank
+
+#endif
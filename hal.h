@@ -0,0 +1,79 @@
+#ifndef SMARTWATCH_HAL_H
+#define SMARTWATCH_HAL_H
+
+// Thin seam between the firmware and the hardware. On the target everything expands
+// straight into the CodeVisionAVR registers, inline assembly and library calls, so
+// nothing is added to the generated code. With the HOST_SIM defined the same firmware
+// is compiled with GCC against the simulated hardware in the host/ folder.
+//
+// Only the accesses which have side effects on other devices have to go through the
+// seam (pins observed by the VFD driver, SPI data, TWI bus actions...), plain register
+// setup and the CodeVisionAVR library calls (delay, sleep) are the same on both.
+
+#ifdef HOST_SIM
+
+#include "host/hal_host.h"
+
+#else
+
+#include <mega88a.h>    // AVR Mega88 PA
+#include <delay.h>      // Delay for-loop functions
+#include <sleep.h>      // Power managment
+
+// CPU clock in Hz, the CodeVisionAVR defines it from the project's clock setting
+#define HAL_F_CPU                   _MCU_CLOCK_FREQUENCY_
+
+
+// Interrupt service routine declaration, the name of the function has to be the
+// one generated by the CodeWizardAVR (timer1_compa_isr, spi_isr...) so the simulator can find it
+#define HAL_ISR(vector)             interrupt [vector]
+
+#define halInterruptsDisable()      #asm("cli")
+#define halInterruptsEnable()       #asm("sei")
+
+// For the code called both from the IRQs and the super loop, the I bit is restored instead of set
+#define halInterruptsSave()         SREG
+#define halInterruptsRestore(state) SREG = (state)
+
+// Compiles to a single SBI/CBI/SBIC instruction as long as the `port` and `pin` are constants
+#define halPinHigh(port, pin)       PORT##port |= (1 << (pin))
+#define halPinLow(port, pin)        PORT##port &= ~(1 << (pin))
+#define halPinRead(port, pin)       (PIN##port & (1 << (pin)))
+
+#define halSpiWrite(data)           SPDR = (data)
+#define halUartWrite(data)          UDR0 = (data)
+
+// Writing TWCR with the TWINT set starts the next TWI bus action (start, byte, stop)
+#define halTwiControl(value)        TWCR = (value)
+
+// The EEMPE has to be followed by the EEPE within 4 cycles, the two SBIs do that
+#define halEepromWrite()            { EECR |= (1 << EEMPE); EECR |= (1 << EEPE); }
+#define halEepromRead()             EECR |= (1 << EERE)
+
+// Interrupt flags are cleared by writing 1 to them, other flags in the register stay untouched
+#define halFlagClear(reg, flag)     reg = (1 << (flag))
+
+// RAM layout of the CodeVisionAVR's small model: the data stack is the first HAL_DATA_STACK_SIZE bytes
+// after the I/O registers (the project's setting, see the main.c header), the globals follow and the
+// hardware stack grows down from the end of the RAM. The globals end far below the watched top of it.
+#define HAL_RAM_START               0x100
+#define HAL_RAM_END                 0x4FF
+#define HAL_DATA_STACK_SIZE         128
+#define HAL_HW_STACK_SIZE           64
+#define halDataStack()              ((uint8_t *)HAL_RAM_START)
+#define halHwStack()                ((uint8_t *)(HAL_RAM_END + 1 - HAL_HW_STACK_SIZE))
+#define halHwStackPointer()         ((uint8_t *)(((uint16_t)SPH << 8) | SPL))
+
+// Idle sleep entered with the IRQs disabled by the caller, who checked there's nothing to do. The
+// instruction after the SEI is executed before any pending IRQ, so one which came after the check
+// wakes the SLEEP right away instead of being served before it and waiting for the next one.
+#define halSleepIdle()              { SMCR = (1 << SE); #asm("sei\nsleep"); }
+
+// Power-down with the BOD disabled. The BODS has to be written within 4 cycles after the BODSE and
+// the SLEEP has to follow within 3 cycles, too tight for the library's powerdown(). The MCUCR is
+// written whole, its PUD and IVSEL bits stay 0 in this firmware.
+#define halPowerDown()              { SMCR = (1 << SM1) | (1 << SE); MCUCR = (1 << BODS) | (1 << BODSE); MCUCR = (1 << BODS); #asm("sleep"); }
+
+#endif
+
+#endif
@@ -0,0 +1,314 @@
+#ifndef SMARTWATCH_HOST_AVR_REGS_H
+#define SMARTWATCH_HOST_AVR_REGS_H
+
+#include <stdint.h>
+
+// ATmega88PA registers and bit positions as plain variables, so the firmware
+// can be compiled with GCC. The simulation reads the configuration from them
+// and updates the flags and counters as the virtual clock advances.
+
+#define HOST_REG8(name)   extern volatile uint8_t  name
+#define HOST_REG16(name)  extern volatile uint16_t name // The xxxL/xxxH halves rely on a little-endian host
+
+// -------- Ports --------
+HOST_REG8(PINB);  HOST_REG8(DDRB);  HOST_REG8(PORTB);
+HOST_REG8(PINC);  HOST_REG8(DDRC);  HOST_REG8(PORTC);
+HOST_REG8(PIND);  HOST_REG8(DDRD);  HOST_REG8(PORTD);
+
+#define PORTB0 0
+#define PORTB1 1
+#define PORTB2 2
+#define PORTB3 3
+#define PORTB4 4
+#define PORTB5 5
+#define PORTB6 6
+#define PORTB7 7
+#define DDB0   0
+#define DDB1   1
+#define DDB2   2
+#define DDB3   3
+#define DDB4   4
+#define DDB5   5
+#define DDB6   6
+#define DDB7   7
+#define PORTC0 0
+#define PORTC1 1
+#define PORTC2 2
+#define PORTC3 3
+#define PORTC4 4
+#define PORTC5 5
+#define PORTC6 6
+#define DDC0   0
+#define DDC1   1
+#define DDC2   2
+#define DDC3   3
+#define DDC4   4
+#define DDC5   5
+#define DDC6   6
+#define PORTD0 0
+#define PORTD1 1
+#define PORTD2 2
+#define PORTD3 3
+#define PORTD4 4
+#define PORTD5 5
+#define PORTD6 6
+#define PORTD7 7
+#define DDD0   0
+#define DDD1   1
+#define DDD2   2
+#define DDD3   3
+#define DDD4   4
+#define DDD5   5
+#define DDD6   6
+#define DDD7   7
+
+// -------- System --------
+HOST_REG8(CLKPR);
+#define CLKPCE 7
+#define CLKPS3 3
+#define CLKPS2 2
+#define CLKPS1 1
+#define CLKPS0 0
+
+HOST_REG8(SMCR);
+#define SM2    3
+#define SM1    2
+#define SM0    1
+#define SE     0
+
+HOST_REG8(MCUCR);
+#define BODS   6
+#define BODSE  5
+#define PUD    4
+
+HOST_REG8(MCUSR);
+#define WDRF   3
+#define BORF   2
+#define EXTRF  1
+#define PORF   0
+
+HOST_REG8(WDTCSR);
+#define WDIF   7
+#define WDIE   6
+#define WDP3   5
+#define WDCE   4
+#define WDE    3
+#define WDP2   2
+#define WDP1   1
+#define WDP0   0
+
+HOST_REG8(PRR);
+#define PRTWI    7
+#define PRTIM2   6
+#define PRTIM0   5
+#define PRTIM1   3
+#define PRSPI    2
+#define PRUSART0 1
+#define PRADC    0
+
+HOST_REG8(SPL);
+HOST_REG8(SPH);
+
+// -------- Timer/Counter 0 --------
+HOST_REG8(TCCR0A); HOST_REG8(TCCR0B); HOST_REG8(TCNT0); HOST_REG8(OCR0A); HOST_REG8(OCR0B);
+HOST_REG8(TIMSK0); HOST_REG8(TIFR0);
+#define COM0A1 7
+#define COM0A0 6
+#define COM0B1 5
+#define COM0B0 4
+#define WGM01  1
+#define WGM00  0
+#define FOC0A  7
+#define FOC0B  6
+#define WGM02  3
+#define CS02   2
+#define CS01   1
+#define CS00   0
+#define OCIE0B 2
+#define OCIE0A 1
+#define TOIE0  0
+#define OCF0B  2
+#define OCF0A  1
+#define TOV0   0
+
+// -------- Timer/Counter 1 --------
+HOST_REG8(TCCR1A); HOST_REG8(TCCR1B); HOST_REG8(TCCR1C);
+HOST_REG16(TCNT1); HOST_REG16(OCR1A); HOST_REG16(OCR1B); HOST_REG16(ICR1);
+HOST_REG8(TIMSK1); HOST_REG8(TIFR1);
+#define TCNT1L (((volatile uint8_t *)&TCNT1)[0])
+#define TCNT1H (((volatile uint8_t *)&TCNT1)[1])
+#define OCR1AL (((volatile uint8_t *)&OCR1A)[0])
+#define OCR1AH (((volatile uint8_t *)&OCR1A)[1])
+#define OCR1BL (((volatile uint8_t *)&OCR1B)[0])
+#define OCR1BH (((volatile uint8_t *)&OCR1B)[1])
+#define ICR1L  (((volatile uint8_t *)&ICR1)[0])
+#define ICR1H  (((volatile uint8_t *)&ICR1)[1])
+#define COM1A1 7
+#define COM1A0 6
+#define COM1B1 5
+#define COM1B0 4
+#define WGM11  1
+#define WGM10  0
+#define ICNC1  7
+#define ICES1  6
+#define WGM13  4
+#define WGM12  3
+#define CS12   2
+#define CS11   1
+#define CS10   0
+#define ICIE1  5
+#define OCIE1B 2
+#define OCIE1A 1
+#define TOIE1  0
+#define ICF1   5
+#define OCF1B  2
+#define OCF1A  1
+#define TOV1   0
+
+// -------- Timer/Counter 2 --------
+HOST_REG8(TCCR2A); HOST_REG8(TCCR2B); HOST_REG8(TCNT2); HOST_REG8(OCR2A); HOST_REG8(OCR2B);
+HOST_REG8(TIMSK2); HOST_REG8(TIFR2); HOST_REG8(ASSR);
+#define COM2A1 7
+#define COM2A0 6
+#define COM2B1 5
+#define COM2B0 4
+#define WGM21  1
+#define WGM20  0
+#define WGM22  3
+#define CS22   2
+#define CS21   1
+#define CS20   0
+#define OCIE2B 2
+#define OCIE2A 1
+#define TOIE2  0
+#define OCF2B  2
+#define OCF2A  1
+#define TOV2   0
+#define EXCLK  6
+#define AS2    5
+
+// -------- External interrupts --------
+HOST_REG8(EICRA); HOST_REG8(EIMSK); HOST_REG8(EIFR);
+HOST_REG8(PCICR); HOST_REG8(PCIFR); HOST_REG8(PCMSK0); HOST_REG8(PCMSK1); HOST_REG8(PCMSK2);
+#define ISC11   3
+#define ISC10   2
+#define ISC01   1
+#define ISC00   0
+#define INT1    1
+#define INT0    0
+#define INTF1   1
+#define INTF0   0
+#define PCIE2   2
+#define PCIE1   1
+#define PCIE0   0
+#define PCIF2   2
+#define PCIF1   1
+#define PCIF0   0
+#define PCINT23 7
+#define PCINT22 6
+#define PCINT21 5
+#define PCINT20 4
+#define PCINT19 3
+#define PCINT18 2
+#define PCINT17 1
+#define PCINT16 0
+
+// -------- SPI --------
+HOST_REG8(SPCR); HOST_REG8(SPSR); HOST_REG8(SPDR);
+#define SPIE   7
+#define SPE    6
+#define DORD   5
+#define MSTR   4
+#define CPOL   3
+#define CPHA   2
+#define SPR1   1
+#define SPR0   0
+#define SPIF   7
+#define WCOL   6
+#define SPI2X  0
+
+// -------- USART0 --------
+HOST_REG8(UCSR0A); HOST_REG8(UCSR0B); HOST_REG8(UCSR0C); HOST_REG8(UDR0);
+HOST_REG16(UBRR0);
+#define UBRR0L (((volatile uint8_t *)&UBRR0)[0])
+#define UBRR0H (((volatile uint8_t *)&UBRR0)[1])
+#define RXC0    7
+#define TXC0    6
+#define UDRE0   5
+#define FE0     4
+#define DOR0    3
+#define UPE0    2
+#define U2X0    1
+#define MPCM0   0
+#define RXCIE0  7
+#define TXCIE0  6
+#define UDRIE0  5
+#define RXEN0   4
+#define TXEN0   3
+#define UCSZ02  2
+#define RXB80   1
+#define TXB80   0
+#define UMSEL01 7
+#define UMSEL00 6
+#define UPM01   5
+#define UPM00   4
+#define USBS0   3
+#define UCSZ01  2
+#define UCSZ00  1
+#define UCPOL0  0
+
+// -------- TWI --------
+HOST_REG8(TWBR); HOST_REG8(TWSR); HOST_REG8(TWAR); HOST_REG8(TWDR); HOST_REG8(TWCR); HOST_REG8(TWAMR);
+#define TWINT  7
+#define TWEA   6
+#define TWSTA  5
+#define TWSTO  4
+#define TWWC   3
+#define TWEN   2
+#define TWIE   0
+#define TWPS1  1
+#define TWPS0  0
+
+// -------- Analog comparator and ADC --------
+HOST_REG8(ACSR); HOST_REG8(ADCSRA); HOST_REG8(ADCSRB); HOST_REG8(ADMUX); HOST_REG8(DIDR0); HOST_REG8(DIDR1);
+HOST_REG16(ADCW);
+#define ADCL   (((volatile uint8_t *)&ADCW)[0])
+#define ADCH   (((volatile uint8_t *)&ADCW)[1])
+#define ACD    7
+#define ACBG   6
+#define ACO    5
+#define ACI    4
+#define ACIE   3
+#define ACIC   2
+#define ACIS1  1
+#define ACIS0  0
+#define ACME   6
+#define AIN1D  1
+#define AIN0D  0
+#define ADEN   7
+#define ADSC   6
+#define ADATE  5
+#define ADIF   4
+#define ADIE   3
+#define ADPS2  2
+#define ADPS1  1
+#define ADPS0  0
+#define REFS1  7
+#define REFS0  6
+#define ADLAR  5
+#define MUX3   3
+#define MUX2   2
+#define MUX1   1
+#define MUX0   0
+
+// -------- EEPROM --------
+HOST_REG8(EECR); HOST_REG8(EEDR);
+HOST_REG16(EEAR);
+#define EEARL  (((volatile uint8_t *)&EEAR)[0])
+#define EEARH  (((volatile uint8_t *)&EEAR)[1])
+#define EERIE  3
+#define EEMPE  2
+#define EEPE   1
+#define EERE   0
+
+#endif
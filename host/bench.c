@@ -0,0 +1,83 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hal_host.h"
+#include "button.h"
+#include "ds3231.h"
+#include "energy.h"
+#include "max6920.h"
+#include "ws2812b.h"
+
+
+// Battery-life benchmark, fast-forwards the firmware through a usage profile
+// and projects the charge used per day:
+//
+//   ./bench -g 12 -h 24 -c 200
+//
+//   -g glances   how many times per hour the watch is woken up by a short press, default 12
+//   -h hours     how long to simulate, default 24 (the result is scaled to a day)
+//   -c mAh       battery capacity for the battery-life projection, default 200
+//   -T celsius   temperature measured by the DS3231, default 25
+//   -v           trace every power-state transition
+
+#define BENCH_GLANCE_PRESS HAL_HOST_MS(200)
+
+
+int main(int argc, char *argv[]) {
+  double   glancesPerHour = 12;
+  double   hours          = 24;
+  double   capacity       = 200;
+  double   celsius        = 25;
+  FILE    *trace          = NULL;
+  uint64_t period, end, at;
+  double   perDay;
+  int      i;
+
+  for (i = 1; i < argc; i++) {
+    if      (!strcmp(argv[i], "-g") && i + 1 < argc) glancesPerHour = atof(argv[++i]);
+    else if (!strcmp(argv[i], "-h") && i + 1 < argc) hours          = atof(argv[++i]);
+    else if (!strcmp(argv[i], "-c") && i + 1 < argc) capacity       = atof(argv[++i]);
+    else if (!strcmp(argv[i], "-T") && i + 1 < argc) celsius        = atof(argv[++i]);
+    else if (!strcmp(argv[i], "-v"))                 trace          = stdout;
+    else {
+      fprintf(stderr, "usage: %s [-g glances_per_hour] [-h hours] [-c battery_mAh] [-T celsius] [-v]\n", argv[0]);
+      return 1;
+    }
+  }
+  if (hours <= 0 || glancesPerHour < 0) {
+    fprintf(stderr, "bench: the hours have to be positive and the glances can't be negative\n");
+    return 1;
+  }
+
+  // Glances evenly spread, the first one after the power-up timeout has expired
+  end = (uint64_t)(hours * HAL_HOST_S(3600));
+  if (glancesPerHour > 0) {
+    period = (uint64_t)(HAL_HOST_S(3600) / glancesPerHour);
+    for (at = period / 2; at + BENCH_GLANCE_PRESS < end; at += period) {
+      if (!buttonAdd(at, BENCH_GLANCE_PRESS)) break;
+    }
+  }
+
+  ds3231Init(8 * 3600, 0);
+  ds3231Temperature(celsius);
+  max6920Init();
+  ws2812bInit(NULL);
+  buttonInit();
+  energyInit(trace);
+
+  halHostRun(end);
+
+  perDay = 24.0 / hours;
+  printf("Profile: %.1f glances/hour over %.1f hours\n", glancesPerHour, hours);
+  printf("CPU active %.1fs, idle %.1fs, power-down %.1fs\n\n",
+         (double)halHostStateCycles[HAL_HOST_ACTIVE]    / HAL_HOST_F_CPU,
+         (double)halHostStateCycles[HAL_HOST_IDLE]      / HAL_HOST_F_CPU,
+         (double)halHostStateCycles[HAL_HOST_POWERDOWN] / HAL_HOST_F_CPU);
+  energyReport(stdout, perDay);
+  printf("\nmAh/day %.3f, %.1f days on a %.0f mAh battery\n",
+         energyTotalMicroampHours() * perDay / 1000.0,
+         capacity * 1000.0 / (energyTotalMicroampHours() * perDay), capacity);
+  return 0;
+}
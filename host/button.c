@@ -0,0 +1,44 @@
+#include <stdint.h>
+
+#include "hal_host.h"
+#include "button.h"
+
+
+typedef struct {
+  uint64_t at;
+  uint64_t hold;
+} buttonPress;
+
+static buttonPress buttonPresses[BUTTON_MAX_PRESSES];
+static uint16_t    buttonCount   = 0;
+static uint16_t    buttonIndex   = 0;   // Next press to happen
+static uint8_t     buttonIsDown  = 0;
+
+
+uint8_t buttonAdd(uint64_t atCycles, uint64_t holdCycles) {
+  if (buttonCount >= BUTTON_MAX_PRESSES) return 0;
+  if (buttonCount && atCycles < buttonPresses[buttonCount - 1].at + buttonPresses[buttonCount - 1].hold) return 0;
+
+  buttonPresses[buttonCount].at   = atCycles;
+  buttonPresses[buttonCount].hold = holdCycles;
+  buttonCount++;
+  return 1;
+}
+
+
+static uint64_t buttonNext(void) {
+  if (buttonIndex >= buttonCount) return HAL_HOST_NEVER;
+  return buttonPresses[buttonIndex].at + (buttonIsDown ? buttonPresses[buttonIndex].hold : 0);
+}
+
+
+static void buttonFire(void) {
+  buttonIsDown = !buttonIsDown;
+  halHostPinInput(HAL_HOST_PORT_D, 2, !buttonIsDown);
+  if (!buttonIsDown) buttonIndex++;
+}
+
+
+void buttonInit(void) {
+  halHostAddSource(buttonNext, buttonFire);
+}
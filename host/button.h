@@ -0,0 +1,13 @@
+#ifndef SMARTWATCH_HOST_BUTTON_H
+#define SMARTWATCH_HOST_BUTTON_H
+
+#include <stdint.h>
+
+// Scripted WAKE-UP button on the PD2, pressing pulls the pin low
+
+#define BUTTON_MAX_PRESSES 256
+
+extern uint8_t buttonAdd(uint64_t atCycles, uint64_t holdCycles);   // Presses have to be added in time order
+extern void    buttonInit(void);
+
+#endif
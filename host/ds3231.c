@@ -0,0 +1,191 @@
+#include <stdint.h>
+
+#include "hal_host.h"
+#include "ds3231.h"
+
+
+#define DS3231_SECONDS_PER_DAY 86400UL
+#define DS3231_INTCN           0x04        // Control register, 1 = ~INT/SQW used for alarms, 0 = square wave
+#define DS3231_FLAGS           0x83        // Status register bits which can only be cleared (OSF, A2F, A1F)
+#define DS3231_A1IE            0x01        // Control register, alarm 1 (and its A1F status flag) pulls the ~INT low
+#define DS3231_A2IE            0x02
+
+static uint8_t  ds3231Registers[DS3231_REGISTERS];
+static uint32_t ds3231Base       = 0;      // Seconds of the day when the time was set
+static uint64_t ds3231BaseCycle  = 0;      // Virtual clock when the time was set
+static uint8_t  ds3231Pointer    = 0;      // Register address for the next TWI read or write
+static uint8_t  ds3231PointerSet = 0;      // The first written byte after the SLA+W is the address
+static uint8_t  ds3231SqwPin     = 1;      // Level currently driven on the PD3
+
+
+static uint8_t ds3231ToBcd(uint8_t value) {
+  return (value / 10) << 4 | (value % 10);
+}
+
+
+static uint8_t ds3231FromBcd(uint8_t value) {
+  return (value >> 4) * 10 + (value & 0x0F);
+}
+
+
+uint32_t ds3231SecondsOfDay(void) {
+  return (ds3231Base + (halHostCycles - ds3231BaseCycle) / HAL_HOST_F_CPU) % DS3231_SECONDS_PER_DAY;
+}
+
+
+void ds3231Temperature(double celsius) {
+  int16_t quarters = (int16_t)(celsius * 4 + ((celsius < 0) ? -0.5 : 0.5));
+
+  ds3231Registers[0x11] = (uint8_t)(quarters >> 2);           // Two's complement whole degrees, rounded down
+  ds3231Registers[0x12] = (uint8_t)((quarters & 3) << 6);     // The fraction in the top 2 bits
+}
+
+
+static void ds3231SetSecondsOfDay(uint32_t seconds) {
+  ds3231Base      = seconds % DS3231_SECONDS_PER_DAY;
+  ds3231BaseCycle = halHostCycles;
+}
+
+
+uint8_t ds3231Read(uint8_t address) {
+  uint32_t seconds = ds3231SecondsOfDay();
+
+  switch (address) {
+    case 0x00: return ds3231ToBcd(seconds % 60);
+    case 0x01: return ds3231ToBcd((seconds / 60) % 60);
+    case 0x02: return ds3231ToBcd(seconds / 3600);     // 24-hour mode
+    default:   return (address < DS3231_REGISTERS) ? ds3231Registers[address] : 0xFF;
+  }
+}
+
+
+void ds3231Write(uint8_t address, uint8_t value) {
+  uint32_t seconds = ds3231SecondsOfDay();
+  uint32_t hour    = seconds / 3600;
+  uint32_t minute  = (seconds / 60) % 60;
+
+  switch (address) {
+    case 0x00: ds3231SetSecondsOfDay(hour * 3600 + minute * 60 + ds3231FromBcd(value & 0x7F)); break;
+    case 0x01: ds3231SetSecondsOfDay(hour * 3600 + ds3231FromBcd(value & 0x7F) * 60 + seconds % 60); break;
+    case 0x02: ds3231SetSecondsOfDay(ds3231FromBcd(value & 0x3F) * 3600 + minute * 60 + seconds % 60); break;
+    case 0x0F: ds3231Registers[0x0F] = (ds3231Registers[0x0F] & value & DS3231_FLAGS) | (value & ~DS3231_FLAGS); break;
+    default:
+      if (address < DS3231_REGISTERS) ds3231Registers[address] = value;
+  }
+}
+
+
+// The 1Hz square wave falls together with the seconds register incrementing
+// and rises half a second later. With the INTCN set the open drain is low only
+// while an enabled alarm has its flag set.
+static uint8_t ds3231SqwLevel(void) {
+  if (ds3231Registers[0x0E] & DS3231_INTCN) return !(ds3231Registers[0x0E] & ds3231Registers[0x0F] & (DS3231_A1IE | DS3231_A2IE));
+  return ((halHostCycles - ds3231BaseCycle) % HAL_HOST_F_CPU) >= HAL_HOST_F_CPU / 2;
+}
+
+
+static uint64_t ds3231SqwNext(void) {
+  uint64_t phase;
+
+  if (ds3231SqwLevel() != ds3231SqwPin) return halHostCycles; // Time was set or the mode changed
+  if (ds3231Registers[0x0E] & DS3231_INTCN) return HAL_HOST_NEVER;
+
+  phase = (halHostCycles - ds3231BaseCycle) % HAL_HOST_F_CPU;
+  return halHostCycles - phase + ((phase < HAL_HOST_F_CPU / 2) ? HAL_HOST_F_CPU / 2 : HAL_HOST_F_CPU);
+}
+
+
+static void ds3231SqwFire(void) {
+  ds3231SqwPin = ds3231SqwLevel();
+  halHostPinInput(HAL_HOST_PORT_D, 3, ds3231SqwPin);
+}
+
+
+// -------- Alarms --------
+// Only the daily modes are modelled (the AxM4 set and the other mask bits 0), and only the
+// alarms with their interrupt enabled, the firmware clears the flags before enabling them anyway
+
+static uint32_t ds3231AlarmSecond(uint8_t alarm) {
+  if (DS3231_A1IE == alarm) {
+    return ds3231FromBcd(ds3231Registers[0x09] & 0x3F) * 3600 + ds3231FromBcd(ds3231Registers[0x08] & 0x7F) * 60 + ds3231FromBcd(ds3231Registers[0x07] & 0x7F);
+  }
+  return ds3231FromBcd(ds3231Registers[0x0C] & 0x3F) * 3600 + ds3231FromBcd(ds3231Registers[0x0B] & 0x7F) * 60;
+}
+
+
+// The alarm matches when the seconds register increments to its time, the start of that second
+static uint64_t ds3231AlarmAt(uint8_t alarm) {
+  uint32_t now    = ds3231SecondsOfDay();
+  uint32_t target = ds3231AlarmSecond(alarm);
+  uint32_t wait   = (target + DS3231_SECONDS_PER_DAY - now) % DS3231_SECONDS_PER_DAY;
+  uint64_t second = halHostCycles - (halHostCycles - ds3231BaseCycle) % HAL_HOST_F_CPU;  // Start of the current second
+
+  if (!wait && second < halHostCycles) wait = DS3231_SECONDS_PER_DAY;  // Later in the matching second, it's tomorrow's
+  return second + (uint64_t)wait * HAL_HOST_F_CPU;
+}
+
+
+static uint64_t ds3231AlarmNext(void) {
+  uint64_t next = HAL_HOST_NEVER;
+  uint64_t at;
+  uint8_t  alarm;
+
+  for (alarm = DS3231_A1IE; alarm <= DS3231_A2IE; alarm <<= 1) {
+    if (!(ds3231Registers[0x0E] & alarm) || (ds3231Registers[0x0F] & alarm)) continue;
+    at = ds3231AlarmAt(alarm);
+    if (at < next) next = at;
+  }
+  return next;
+}
+
+
+static void ds3231AlarmFire(void) {
+  uint8_t alarm;
+
+  for (alarm = DS3231_A1IE; alarm <= DS3231_A2IE; alarm <<= 1) {
+    if (!(ds3231Registers[0x0E] & alarm) || (ds3231Registers[0x0F] & alarm)) continue;
+    if (ds3231SecondsOfDay() == ds3231AlarmSecond(alarm)) ds3231Registers[0x0F] |= alarm;  // A1F and A2F have the same bits as the IEs
+  }
+}
+
+
+// -------- TWI slave --------
+// The register pointer auto-increments and wraps around after the last register
+
+static void ds3231TwiStart(uint8_t read) {
+  ds3231PointerSet = read;
+}
+
+
+static uint8_t ds3231TwiWrite(uint8_t data) {
+  if (!ds3231PointerSet) {
+    ds3231Pointer    = data % DS3231_REGISTERS;
+    ds3231PointerSet = 1;
+    return 1;
+  }
+  ds3231Write(ds3231Pointer, data);
+  ds3231Pointer = (ds3231Pointer + 1) % DS3231_REGISTERS;
+  return 1;
+}
+
+
+static uint8_t ds3231TwiRead(void) {
+  uint8_t data = ds3231Read(ds3231Pointer);
+
+  ds3231Pointer = (ds3231Pointer + 1) % DS3231_REGISTERS;
+  return data;
+}
+
+
+static const halHostTwiDevice ds3231Twi = { DS3231_ADDRESS, ds3231TwiStart, ds3231TwiWrite, ds3231TwiRead };
+
+
+void ds3231Init(uint32_t secondsOfDay, uint8_t lost) {
+  ds3231SetSecondsOfDay(secondsOfDay);
+  ds3231Registers[0x0E] = 0x1C;            // Power-on state of the control register
+  ds3231Registers[0x0F] = lost ? 0x80 : 0; // OSF, the oscillator was stopped
+  ds3231Temperature(25);
+  halHostAddSource(ds3231SqwNext, ds3231SqwFire);
+  halHostAddSource(ds3231AlarmNext, ds3231AlarmFire);
+  halHostAddTwiDevice(&ds3231Twi);
+}
@@ -0,0 +1,18 @@
+#ifndef SMARTWATCH_HOST_DS3231_H
+#define SMARTWATCH_HOST_DS3231_H
+
+#include <stdint.h>
+
+// DS3231M real time clock register model, the time is derived from the virtual clock,
+// the ~INT/SQW open drain output is driven on the PD3
+
+#define DS3231_ADDRESS   0x68                          // 7-bit TWI address
+#define DS3231_REGISTERS 0x13
+
+extern void     ds3231Init(uint32_t secondsOfDay, uint8_t lost); // Time the RTC has when the simulation starts, `lost` sets the OSF
+extern uint32_t ds3231SecondsOfDay(void);
+extern void     ds3231Temperature(double celsius);     // The last conversion, in 0.25C steps as the DS3231M has them
+extern uint8_t  ds3231Read(uint8_t address);           // Register access (BCD encoded time)
+extern void     ds3231Write(uint8_t address, uint8_t value);
+
+#endif
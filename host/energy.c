@@ -0,0 +1,169 @@
+#include <stdint.h>
+#include <stdio.h>
+
+#include "hal_host.h"
+#include "energy.h"
+
+
+// Typical datasheet values at 3V, they are estimates of this board and should be
+// corrected with measurements, the relative changes between firmware versions matter most
+energyConsumer energyConsumers[ENERGY_CONSUMERS] = {
+  { "RTC standby",       100.0 },  // DS3231M IDDS powered from VCC
+  { "Neopixel idle",     600.0 },  // WS2812B quiescent
+  { "BOD",                20.0 },  // ATmega88PA brown-out detector enabled by the fuses
+  { "CPU active",       3000.0 },  // ATmega88PA at 8MHz
+  { "CPU idle",          900.0 },
+  { "CPU power-down",      0.1 },  // Watchdog off
+  { "SPI",                50.0 },
+  { "TWI",               300.0 },  // TWI module + DS3231M IDDA during the transfer
+  { "DC2DC",            3000.0 },  // NCP3064 switching without a load
+  { "VFD segments",     1500.0 },  // Per segment glowing
+  { "Filament",        50000.0 },
+  { "Neopixel",           47.0 },  // Per colour unit, ~12mA for a full channel
+  { "ADC",               250.0 },  // ATmega88PA ADC at 125kHz plus the bandgap
+  { "I/O clocks",          1.0 },  // Level is the sum of the energyClockMicroamps
+  { "Motor",           60000.0 },  // Coin vibration motor
+};
+
+// Supply current of each module while it's clocked (PRR bit 0), ATmega88PA at 8MHz and 3V
+static const uint8_t energyClockMicroamps[8] = {
+  30,  // PRADC
+  44,  // PRUSART0
+  44,  // PRSPI
+  26,  // PRTIM1
+  0,   // Reserved
+  13,  // PRTIM0
+  54,  // PRTIM2
+  60   // PRTWI
+};
+
+static uint8_t energyCpuState = HAL_HOST_ACTIVE;
+
+static FILE *energyTrace = NULL;
+
+
+static void energyAccount(energyConsumer *consumer) {
+  uint64_t elapsed = halHostCycles - consumer->since;
+
+  consumer->unitCycles += (double)consumer->level * elapsed;
+  consumer->stateUnitCycles[energyCpuState] += (double)consumer->level * elapsed;
+  if (consumer->level) consumer->onCycles += elapsed;
+  consumer->since = halHostCycles;
+}
+
+
+void energySet(uint8_t consumer, uint32_t level) {
+  energyConsumer *target = &energyConsumers[consumer];
+
+  if (target->level == level) return;
+  energyAccount(target);
+  if (energyTrace) {
+    fprintf(energyTrace, "%14.6fs  %-16s %u -> %u\n", (double)halHostCycles / HAL_HOST_F_CPU, target->name, target->level, level);
+  }
+  target->level = level;
+  target->transitions++;
+}
+
+
+double energyMicroampHours(uint8_t consumer) {
+  energyConsumer *target = &energyConsumers[consumer];
+
+  energyAccount(target);
+  return target->microampsPerUnit * target->unitCycles / HAL_HOST_F_CPU / 3600.0;
+}
+
+
+double energyTotalMicroampHours(void) {
+  double  total = 0;
+  uint8_t i;
+
+  for (i = 0; i < ENERGY_CONSUMERS; i++) total += energyMicroampHours(i);
+  return total;
+}
+
+
+static void energyOnPinWrite(uint8_t port, uint8_t pin, uint8_t level) {
+  if (HAL_HOST_PORT_D == port && 4 == pin) energySet(ENERGY_DC2DC,    level);
+  if (HAL_HOST_PORT_B == port && 1 == pin) energySet(ENERGY_FILAMENT, level);
+  if (HAL_HOST_PORT_D == port && 5 == pin) energySet(ENERGY_MOTOR,    level);
+}
+
+
+static void energyOnActivity(uint8_t what, uint32_t level) {
+  uint32_t microamps = 0;
+  uint8_t  i;
+
+  switch (what) {
+    case HAL_HOST_ACTIVITY_SLEEP:
+      // Everything up to now was consumed in the previous CPU state
+      for (i = 0; i < ENERGY_CONSUMERS; i++) energyAccount(&energyConsumers[i]);
+      energyCpuState = level;
+      energySet(ENERGY_CPU_ACTIVE,    HAL_HOST_ACTIVE    == level);
+      energySet(ENERGY_CPU_IDLE,      HAL_HOST_IDLE      == level);
+      energySet(ENERGY_CPU_POWERDOWN, HAL_HOST_POWERDOWN == level);
+      break;
+
+    case HAL_HOST_ACTIVITY_SPI:      energySet(ENERGY_SPI,          level); break;
+    case HAL_HOST_ACTIVITY_TWI:      energySet(ENERGY_TWI,          level); break;
+    case HAL_HOST_ACTIVITY_VFD:      energySet(ENERGY_VFD_SEGMENTS, level); break;
+    case HAL_HOST_ACTIVITY_NEOPIXEL: energySet(ENERGY_NEOPIXEL,     level); break;
+    case HAL_HOST_ACTIVITY_ADC:      energySet(ENERGY_ADC,          level); break;
+    case HAL_HOST_ACTIVITY_BOD:      energySet(ENERGY_BOD,          level); break;
+    case HAL_HOST_ACTIVITY_CLOCKS:
+      for (i = 0; i < 8; i++) {
+        if (level & (1 << i)) microamps += energyClockMicroamps[i];
+      }
+      energySet(ENERGY_CLOCKS, microamps);
+      break;
+  }
+}
+
+
+void energyInit(FILE *trace) {
+  energyTrace = trace;
+  halHostOnPinWrite(energyOnPinWrite);
+  halHostOnActivity(energyOnActivity);
+
+  // Powered from the reset
+  energySet(ENERGY_RTC_STANDBY,   1);
+  energySet(ENERGY_NEOPIXEL_IDLE, 1);
+  energySet(ENERGY_BOD,           1);
+  energySet(ENERGY_CPU_ACTIVE,    1);
+}
+
+
+// Current budget of each CPU state, everything consumed while the CPU was in it
+static void energyStateReport(FILE *output, double scaleToDay) {
+  static const char *names[3] = { "CPU active", "CPU idle", "CPU power-down" };
+  uint8_t state, i;
+
+  fprintf(output, "\n%-16s %12s %12s %12s\n", "State", "Time [s]", "Average [uA]", "mAh/day");
+  for (state = 0; state < 3; state++) {
+    double seconds = (double)halHostStateCycles[state] / HAL_HOST_F_CPU;
+    double used    = 0;
+
+    for (i = 0; i < ENERGY_CONSUMERS; i++) {
+      used += energyConsumers[i].microampsPerUnit * energyConsumers[i].stateUnitCycles[state] / HAL_HOST_F_CPU / 3600.0;
+    }
+    fprintf(output, "%-16s %12.1f %12.1f %12.3f\n", names[state], seconds,
+            (seconds > 0) ? used * 3600.0 / seconds : 0.0, used * scaleToDay / 1000.0);
+  }
+}
+
+
+void energyReport(FILE *output, double scaleToDay) {
+  double  total = energyTotalMicroampHours();
+  uint8_t i;
+
+  fprintf(output, "%-16s %12s %12s %12s %7s\n", "Consumer", "On [s]", "Transitions", "mAh/day", "Share");
+  for (i = 0; i < ENERGY_CONSUMERS; i++) {
+    energyConsumer *consumer = &energyConsumers[i];
+    double          used     = energyMicroampHours(i);
+
+    fprintf(output, "%-16s %12.1f %12u %12.3f %6.2f%%\n", consumer->name,
+            (double)consumer->onCycles / HAL_HOST_F_CPU, consumer->transitions,
+            used * scaleToDay / 1000.0, (total > 0) ? 100.0 * used / total : 0.0);
+  }
+  fprintf(output, "%-16s %12s %12s %12.3f\n", "Total", "", "", total * scaleToDay / 1000.0);
+  energyStateReport(output, scaleToDay);
+}
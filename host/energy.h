@@ -0,0 +1,47 @@
+#ifndef SMARTWATCH_HOST_ENERGY_H
+#define SMARTWATCH_HOST_ENERGY_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+// Energy accounting of the simulated watch. Every power-state transition of the
+// consumers below is timestamped with the virtual clock, the time spent in each
+// state is multiplied with the current from the energyConsumers table.
+
+#define ENERGY_RTC_STANDBY      0  // DS3231M keeping the time
+#define ENERGY_NEOPIXEL_IDLE    1  // WS2812B quiescent current, even when black
+#define ENERGY_BOD              2  // Brown-out detector
+#define ENERGY_CPU_ACTIVE       3
+#define ENERGY_CPU_IDLE         4
+#define ENERGY_CPU_POWERDOWN    5
+#define ENERGY_SPI              6  // SPI shifting
+#define ENERGY_TWI              7  // TWI transaction, both the MCU and the DS3231M active current
+#define ENERGY_DC2DC            8  // NCP3064 boost converter enabled by PD4 (without load)
+#define ENERGY_VFD_SEGMENTS     9  // Anode current of each glowing segment, level = segments lit
+#define ENERGY_FILAMENT         10 // VFD filament switched by PB1
+#define ENERGY_NEOPIXEL         11 // level = sum of the colour channels (0-255 each)
+#define ENERGY_ADC              12 // ADC converting, including the bandgap reference
+#define ENERGY_CLOCKS           13 // Digital modules not gated by the PRR, level = their uA
+#define ENERGY_MOTOR            14 // Vibration motor switched by PD5
+#define ENERGY_CONSUMERS        15
+
+typedef struct {
+  const char *name;
+  double      microampsPerUnit;  // Battery current for level 1
+  uint32_t    level;             // Current level (0 = off)
+  uint64_t    since;             // When the level changed last time
+  double      unitCycles;        // Sum of level * cycles
+  double      stateUnitCycles[3];// The same split by the CPU state (HAL_HOST_ACTIVE/IDLE/POWERDOWN)
+  uint64_t    onCycles;          // How long the level was not 0
+  uint32_t    transitions;
+} energyConsumer;
+
+extern energyConsumer energyConsumers[ENERGY_CONSUMERS];
+
+extern void   energyInit(FILE *trace);                      // Trace of the transitions is optional (NULL)
+extern void   energySet(uint8_t consumer, uint32_t level);
+extern double energyMicroampHours(uint8_t consumer);        // Charge used so far
+extern double energyTotalMicroampHours(void);
+extern void   energyReport(FILE *output, double scaleToDay); // Per consumer breakdown, scaled to the mAh per day
+
+#endif
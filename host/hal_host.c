@@ -0,0 +1,789 @@
+#include <setjmp.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "hal_host.h"
+#include "ws2812b.h"
+
+
+// -------- Registers --------
+volatile uint8_t  PINB, DDRB, PORTB, PINC, DDRC, PORTC, PIND, DDRD, PORTD;
+volatile uint8_t  CLKPR, SMCR, MCUCR, MCUSR, WDTCSR, PRR, SPL, SPH;
+volatile uint8_t  TCCR0A, TCCR0B, TCNT0, OCR0A, OCR0B, TIMSK0, TIFR0;
+volatile uint8_t  TCCR1A, TCCR1B, TCCR1C, TIMSK1, TIFR1;
+volatile uint16_t TCNT1, OCR1A, OCR1B, ICR1;
+volatile uint8_t  TCCR2A, TCCR2B, TCNT2, OCR2A, OCR2B, TIMSK2, TIFR2, ASSR;
+volatile uint8_t  EICRA, EIMSK, EIFR, PCICR, PCIFR, PCMSK0, PCMSK1, PCMSK2;
+volatile uint8_t  SPCR, SPSR, SPDR;
+volatile uint8_t  UCSR0A, UCSR0B, UCSR0C, UDR0;
+volatile uint16_t UBRR0;
+volatile uint8_t  TWBR, TWSR, TWAR, TWDR, TWCR, TWAMR;
+volatile uint8_t  ACSR, ADCSRA, ADCSRB, ADMUX, DIDR0, DIDR1;
+volatile uint16_t ADCW;
+volatile uint8_t  EECR, EEDR;
+volatile uint16_t EEAR;
+
+
+// -------- Firmware entry points --------
+// Only the ISRs the firmware implements are linked in, the rest stays NULL
+extern void firmwareMain(void);
+extern void pin_change_isr2(void)  __attribute__((weak));
+extern void timer2_compa_isr(void) __attribute__((weak));
+extern void timer2_compb_isr(void) __attribute__((weak));
+extern void timer2_ovf_isr(void)   __attribute__((weak));
+extern void timer1_compa_isr(void) __attribute__((weak));
+extern void timer1_compb_isr(void) __attribute__((weak));
+extern void timer1_ovf_isr(void)   __attribute__((weak));
+extern void timer0_compa_isr(void) __attribute__((weak));
+extern void timer0_compb_isr(void) __attribute__((weak));
+extern void timer0_ovf_isr(void)   __attribute__((weak));
+extern void spi_isr(void)          __attribute__((weak));
+extern void usart_rx_isr(void)     __attribute__((weak));
+extern void usart_dre_isr(void)    __attribute__((weak));
+extern void usart_tx_isr(void)     __attribute__((weak));
+extern void adc_isr(void)          __attribute__((weak));
+extern void ee_rdy_isr(void)       __attribute__((weak));
+extern void twi_isr(void)          __attribute__((weak));
+
+
+#define HOST_ISR_ENTRY_CYCLES   24 // Vector jump and the CodeVisionAVR register saving
+#define HOST_ISR_EXIT_CYCLES    20 // Register restoring and RETI
+#define HOST_WAKEUP_CYCLES      6  // Start-up from the power-down with the internal RC oscillator
+#define HOST_PIN_CYCLES         2  // SBI/CBI
+#define HOST_MAX_SOURCES        16
+#define HOST_MAX_OBSERVERS      8
+#define HOST_MAX_TWI_DEVICES    4
+#define HOST_EEPROM_WRITE_CYCLES HAL_HOST_US(3400) // Erase and write of one byte, timed by the 128kHz oscillator
+#define HOST_ADC_FIRST_CLOCKS   25 // The first conversion after the ADEN also initializes the analog circuitry
+#define HOST_ADC_CLOCKS         13
+#define HOST_ADC_BANDGAP_MV     1100
+#define HOST_BOD_WAKEUP_CYCLES  HAL_HOST_US(60) // The BOD disabled in the sleep has to start again before the CPU runs
+
+
+// The EEPROM ready IRQ has no flag, it's requested for as long as no write is in progress
+static volatile uint8_t hostEepromReady = 1;
+
+
+// Interrupt vectors in the priority order, entering the ISR clears the flag unless
+// the flag has to be cleared by the firmware (TWINT) or it's a level (EEPROM ready)
+typedef struct {
+  volatile uint8_t *flagReg;
+  uint8_t           flagBit;
+  volatile uint8_t *enableReg;
+  uint8_t           enableBit;
+  uint8_t           wakesPowerDown;
+  uint8_t           clearedOnEntry;
+  void            (*isr)(void);
+} hostVector;
+
+static hostVector hostVectors[] = {
+  { &PCIFR, PCIF2, &PCICR,  PCIE2,  1, 1, pin_change_isr2  },
+  { &TIFR2, OCF2A, &TIMSK2, OCIE2A, 0, 1, timer2_compa_isr },
+  { &TIFR2, OCF2B, &TIMSK2, OCIE2B, 0, 1, timer2_compb_isr },
+  { &TIFR2, TOV2,  &TIMSK2, TOIE2,  0, 1, timer2_ovf_isr   },
+  { &TIFR1, OCF1A, &TIMSK1, OCIE1A, 0, 1, timer1_compa_isr },
+  { &TIFR1, OCF1B, &TIMSK1, OCIE1B, 0, 1, timer1_compb_isr },
+  { &TIFR1, TOV1,  &TIMSK1, TOIE1,  0, 1, timer1_ovf_isr   },
+  { &TIFR0, OCF0A, &TIMSK0, OCIE0A, 0, 1, timer0_compa_isr },
+  { &TIFR0, OCF0B, &TIMSK0, OCIE0B, 0, 1, timer0_compb_isr },
+  { &TIFR0, TOV0,  &TIMSK0, TOIE0,  0, 1, timer0_ovf_isr   },
+  { &SPSR,  SPIF,  &SPCR,   SPIE,   0, 1, spi_isr          },
+  { &UCSR0A, RXC0, &UCSR0B, RXCIE0, 0, 1, usart_rx_isr     },  // The RXC0 is cleared by reading the UDR0, close enough
+  { &UCSR0A, UDRE0, &UCSR0B, UDRIE0, 0, 0, usart_dre_isr   },
+  { &UCSR0A, TXC0, &UCSR0B, TXCIE0, 0, 1, usart_tx_isr     },
+  { &ADCSRA, ADIF, &ADCSRA, ADIE,   0, 1, adc_isr          },
+  { &hostEepromReady, 0, &EECR, EERIE, 0, 0, ee_rdy_isr    },
+  { &TWCR,  TWINT, &TWCR,   TWIE,   0, 0, twi_isr          },
+};
+#define HOST_VECTORS (sizeof(hostVectors) / sizeof(hostVectors[0]))
+
+
+// Synchronous timers, all three are stopped in the power-down (no clk_io)
+typedef struct {
+  volatile uint8_t  *tccrA;
+  volatile uint8_t  *tccrB;
+  volatile uint8_t  *tifr;
+  volatile uint8_t  *cnt8;     // Either 8-bit or 16-bit registers are used
+  volatile uint8_t  *ocrA8;
+  volatile uint8_t  *ocrB8;
+  volatile uint16_t *cnt16;
+  volatile uint16_t *ocrA16;
+  volatile uint16_t *ocrB16;
+  const uint16_t    *prescalers;
+  uint8_t            prrBit;
+  uint32_t           residue;  // Cycles accumulated towards the next timer tick
+} hostTimer;
+
+static const uint16_t hostPrescalers01[8] = { 0, 1, 8, 64, 256, 1024, 0, 0 };  // 6 and 7 are external clocks
+static const uint16_t hostPrescalers2[8]  = { 0, 1, 8, 32, 64, 128, 256, 1024 };
+
+static hostTimer hostTimers[3] = {
+  { &TCCR0A, &TCCR0B, &TIFR0, &TCNT0, &OCR0A, &OCR0B, NULL,   NULL,   NULL,   hostPrescalers01, PRTIM0, 0 },
+  { &TCCR1A, &TCCR1B, &TIFR1, NULL,   NULL,   NULL,   &TCNT1, &OCR1A, &OCR1B, hostPrescalers01, PRTIM1, 0 },
+  { &TCCR2A, &TCCR2B, &TIFR2, &TCNT2, &OCR2A, &OCR2B, NULL,   NULL,   NULL,   hostPrescalers2,  PRTIM2, 0 },
+};
+
+
+uint64_t halHostCycles                 = 0;
+uint8_t  halHostSleepState             = HAL_HOST_ACTIVE;
+uint64_t halHostStateCycles[3]         = { 0, 0, 0 };
+uint32_t halHostIsrCount               = 0;
+uint32_t halHostSpiCollisions          = 0;
+uint32_t halHostTwiTransactions        = 0;
+uint64_t halHostTwiBusCycles           = 0;
+uint8_t  halHostEeprom[HAL_HOST_EEPROM_SIZE] = { [0 ... HAL_HOST_EEPROM_SIZE - 1] = 0xFF };  // Erased
+uint32_t halHostEepromWrites           = 0;
+uint16_t halHostBatteryMillivolts      = 3900;
+uint8_t  halHostDataStack[HAL_DATA_STACK_SIZE];
+uint8_t  halHostHwStack[HAL_HW_STACK_SIZE];
+uint32_t halHostStackDeepest           = 0;
+uint64_t halHostStackDeepestAt         = 0;
+uint8_t  halHostStackDeepestInIsr      = 0;
+
+static uint64_t hostEndCycles          = HAL_HOST_NEVER;
+static jmp_buf  hostEnd;
+static uint8_t  hostInterruptsEnabled  = 0;
+static uint8_t  hostSleepEnabled       = 0;
+static uint64_t hostSpiDoneAt          = HAL_HOST_NEVER;
+static uint8_t  hostSpiData            = 0;
+static uint64_t hostEepromDoneAt       = HAL_HOST_NEVER;
+static uint64_t hostAdcDoneAt          = HAL_HOST_NEVER;
+static uint8_t  hostAdcWarm            = 0;     // The ADEN stayed set since the last conversion
+static uint8_t  hostClocked            = 0;     // Modules with the clock (PRR bits inverted) last reported
+static uint64_t hostUartShiftedAt      = HAL_HOST_NEVER;  // The byte in the TX shift register is out
+static uint8_t  hostUartShifting       = 0;     // Byte in the TX shift register
+static uint8_t  hostUartBuffered       = 0;     // The UDR0 has the next byte (UDRE0 is 0)
+static uint8_t  hostUartNext           = 0;
+static uint64_t hostWokeAt             = 0;     // The last power-down ended, the USART's clock started again
+static uintptr_t hostStackTop          = 0;     // The halHostRun's frame, the stack grows down from it
+static uint8_t  hostInIsr              = 0;
+
+static const halHostTwiDevice *hostTwiDevices[HOST_MAX_TWI_DEVICES];
+static uint8_t                 hostTwiDeviceCount = 0;
+static const halHostTwiDevice *hostTwiSlave       = NULL;  // Addressed device, NULL when nobody answered
+static uint64_t                hostTwiDoneAt      = HAL_HOST_NEVER;
+static uint64_t                hostTwiTakenAt     = 0;
+static uint8_t                 hostTwiStatus      = 0xF8;  // Loaded into the TWSR when the bus action finishes
+static uint8_t                 hostTwiData        = 0;     // Received byte, loaded into the TWDR
+static uint8_t                 hostTwiTaken       = 0;     // Start condition sent and no stop yet
+static uint8_t                 hostTwiAddressNext = 0;     // The next byte is the SLA+R/W
+static uint8_t                 hostTwiReading     = 0;     // Addressed with the SLA+R
+static uint8_t                 hostTwiReceived    = 0;     // The bus action was a byte from the slave
+
+static uint64_t (*hostSourceNext[HOST_MAX_SOURCES])(void);
+static void     (*hostSourceFire[HOST_MAX_SOURCES])(void);
+static uint8_t    hostSources          = 0;
+
+static void (*hostPinObservers[HOST_MAX_OBSERVERS])(uint8_t port, uint8_t pin, uint8_t level);
+static uint8_t hostPinObserverCount    = 0;
+static void (*hostSpiObservers[HOST_MAX_OBSERVERS])(uint8_t data);
+static uint8_t hostSpiObserverCount    = 0;
+static void (*hostActivityObservers[HOST_MAX_OBSERVERS])(uint8_t what, uint32_t level);
+static uint8_t hostActivityObserverCount = 0;
+static void (*hostUartObservers[HOST_MAX_OBSERVERS])(uint8_t data);
+static uint8_t hostUartObserverCount   = 0;
+
+
+void halHostAddSource(uint64_t (*next)(void), void (*fire)(void)) {
+  if (hostSources >= HOST_MAX_SOURCES) {
+    fprintf(stderr, "hal_host: too many event sources\n");
+    return;
+  }
+  hostSourceNext[hostSources] = next;
+  hostSourceFire[hostSources] = fire;
+  hostSources++;
+}
+
+
+void halHostOnPinWrite(void (*observer)(uint8_t port, uint8_t pin, uint8_t level)) {
+  if (hostPinObserverCount < HOST_MAX_OBSERVERS) hostPinObservers[hostPinObserverCount++] = observer;
+}
+
+
+void halHostOnSpiByte(void (*observer)(uint8_t data)) {
+  if (hostSpiObserverCount < HOST_MAX_OBSERVERS) hostSpiObservers[hostSpiObserverCount++] = observer;
+}
+
+
+void halHostOnUartByte(void (*observer)(uint8_t data)) {
+  if (hostUartObserverCount < HOST_MAX_OBSERVERS) hostUartObservers[hostUartObserverCount++] = observer;
+}
+
+
+void halHostOnActivity(void (*observer)(uint8_t what, uint32_t level)) {
+  if (hostActivityObserverCount < HOST_MAX_OBSERVERS) hostActivityObservers[hostActivityObserverCount++] = observer;
+}
+
+
+void halHostActivity(uint8_t what, uint32_t level) {
+  uint8_t i;
+
+  for (i = 0; i < hostActivityObserverCount; i++) hostActivityObservers[i](what, level);
+}
+
+
+// -------- Timers --------
+
+static uint16_t timerRead(volatile uint8_t *reg8, volatile uint16_t *reg16) {
+  return (reg16) ? *reg16 : *reg8;
+}
+
+
+static uint16_t timerPrescaler(hostTimer *timer) {
+  if (HAL_HOST_POWERDOWN == halHostSleepState) return 0;
+  if (PRR & (1 << timer->prrBit))               return 0;
+  return timer->prescalers[*timer->tccrB & 0x07];
+}
+
+
+// The TOP of the counter, only the normal and CTC modes are simulated, PWM modes count as normal
+static uint16_t timerTop(hostTimer *timer, uint8_t *ctc) {
+  uint8_t wgm;
+
+  if (timer->cnt16) {
+    wgm = ((*timer->tccrB >> WGM12) & 0x03) << 2 | (*timer->tccrA & 0x03);
+    *ctc = (4 == wgm) || (12 == wgm);
+    if (4  == wgm) return OCR1A;
+    if (12 == wgm) return ICR1;
+    return 0xFFFF;
+  }
+  wgm  = ((*timer->tccrB >> WGM02) & 0x01) << 2 | (*timer->tccrA & 0x03);
+  *ctc = (2 == wgm);
+  return (2 == wgm) ? *timer->ocrA8 : 0xFF;
+}
+
+
+// How many timer ticks until the counter reaches the `target` value
+static uint32_t timerTicksUntil(uint16_t count, uint16_t target, uint16_t top) {
+  if (target > top)  return UINT32_MAX;     // Compare value outside of the counting range never matches
+  if (count  > top)  return (uint32_t)(0xFFFF - count) + 1 + target;
+  if (target > count) return target - count;
+  return (uint32_t)(top - count) + 1 + target;
+}
+
+
+static uint32_t timerTicksToEvent(hostTimer *timer) {
+  uint8_t  ctc;
+  uint16_t top   = timerTop(timer, &ctc);
+  uint16_t count = timerRead(timer->cnt8, timer->cnt16);
+  uint32_t ticks = timerTicksUntil(count, timerRead(timer->ocrA8, timer->ocrA16), top);
+  uint32_t other = timerTicksUntil(count, timerRead(timer->ocrB8, timer->ocrB16), top);
+
+  if (other < ticks) ticks = other;
+  if (!ctc) {
+    other = timerTicksUntil(count, 0, top);  // Overflow
+    if (other < ticks) ticks = other;
+  }
+  return ticks;
+}
+
+
+static uint64_t timerNext(hostTimer *timer) {
+  uint16_t prescaler = timerPrescaler(timer);
+  uint32_t ticks;
+
+  if (0 == prescaler) return HAL_HOST_NEVER;
+  ticks = timerTicksToEvent(timer);
+  if (UINT32_MAX == ticks) return HAL_HOST_NEVER;
+  return halHostCycles + (uint64_t)ticks * prescaler - timer->residue;
+}
+
+
+static void timerAdvance(hostTimer *timer, uint64_t cycles) {
+  uint16_t prescaler = timerPrescaler(timer);
+  uint64_t total;
+  uint32_t ticks;
+  uint16_t count, top;
+  uint8_t  ctc;
+
+  if (0 == prescaler) return;
+  total           = timer->residue + cycles;
+  ticks           = total / prescaler;
+  timer->residue  = total % prescaler;
+  if (0 == ticks) return;
+
+  top   = timerTop(timer, &ctc);
+  count = timerRead(timer->cnt8, timer->cnt16);
+  if (timerTicksUntil(count, timerRead(timer->ocrA8, timer->ocrA16), top) <= ticks) *timer->tifr |= (1 << 1); // OCFnA
+  if (timerTicksUntil(count, timerRead(timer->ocrB8, timer->ocrB16), top) <= ticks) *timer->tifr |= (1 << 2); // OCFnB
+  if (!ctc && timerTicksUntil(count, 0, top) <= ticks)                               *timer->tifr |= (1 << 0); // TOVn
+
+  if (count > top) top = timer->cnt16 ? 0xFFFF : 0xFF;
+  count = (uint16_t)((count + ticks) % ((uint32_t)top + 1));
+  if (timer->cnt16) *timer->cnt16 = count; else *timer->cnt8 = (uint8_t)count;
+}
+
+
+// -------- Clock --------
+
+static void hostSpiFire(void) {
+  uint8_t i;
+
+  hostSpiDoneAt  = HAL_HOST_NEVER;
+  SPSR          |= (1 << SPIF);
+  halHostActivity(HAL_HOST_ACTIVITY_SPI, 0);
+  for (i = 0; i < hostSpiObserverCount; i++) hostSpiObservers[i](hostSpiData);
+}
+
+
+static void hostTwiFire(void) {
+  hostTwiDoneAt  = HAL_HOST_NEVER;
+  TWSR           = (TWSR & 0x03) | hostTwiStatus;
+  if (hostTwiReceived) TWDR = hostTwiData;
+  TWCR          |= (1 << TWINT);
+}
+
+
+static void hostEepromFire(void) {
+  hostEepromDoneAt  = HAL_HOST_NEVER;
+  EECR             &= ~(1 << EEPE);
+  hostEepromReady   = 1;
+}
+
+
+// The UDRE0 is read-only on the chip, the firmware writing the UCSR0A can't clear it
+static void hostUartCheck(void) {
+  if (!hostUartBuffered) UCSR0A |= (1 << UDRE0);
+}
+
+
+// The last stop bit is out, the buffered byte (if any) goes to the shift register
+static void hostUartFire(void) {
+  uint8_t i;
+
+  hostUartShiftedAt = HAL_HOST_NEVER;
+  for (i = 0; i < hostUartObserverCount; i++) hostUartObservers[i](hostUartShifting);
+  if (hostUartBuffered) {
+    hostUartBuffered  = 0;
+    hostUartShifting  = hostUartNext;
+    hostUartShiftedAt = halHostCycles + halHostUartFrameCycles();
+    UCSR0A           |= (1 << UDRE0);
+  } else {
+    UCSR0A           |= (1 << TXC0);
+  }
+}
+
+
+// The ADC has no write hook, a conversion is noticed from the ADSC when looking for the next event
+static void hostAdcStart(void) {
+  uint8_t  adps      = ADCSRA & 0x07;
+  uint16_t prescaler = adps ? (1 << adps) : 2;
+
+  if (!(ADCSRA & (1 << ADEN))) hostAdcWarm = 0;
+  if (HAL_HOST_NEVER != hostAdcDoneAt) return;
+  if ((ADCSRA & ((1 << ADEN) | (1 << ADSC))) != ((1 << ADEN) | (1 << ADSC))) return;
+  if (PRR & (1 << PRADC)) return;                 // Not clocked, the conversion never finishes
+
+  hostAdcDoneAt = halHostCycles + (uint64_t)prescaler * (hostAdcWarm ? HOST_ADC_CLOCKS : HOST_ADC_FIRST_CLOCKS);
+  halHostActivity(HAL_HOST_ACTIVITY_ADC, 1);
+}
+
+
+// Only the 1.1V bandgap input (MUX 1110) against the AVCC is modelled, it's what the battery monitor measures
+static void hostAdcFire(void) {
+  uint32_t result = (uint32_t)HOST_ADC_BANDGAP_MV * 1024 / (halHostBatteryMillivolts ? halHostBatteryMillivolts : 1);
+
+  hostAdcDoneAt = HAL_HOST_NEVER;
+  hostAdcWarm   = 1;
+  ADCW          = (0x0E == (ADMUX & 0x0F)) ? ((result > 1023) ? 1023 : result) : 0;
+  ADCSRA        = (ADCSRA & ~(1 << ADSC)) | (1 << ADIF);
+  halHostActivity(HAL_HOST_ACTIVITY_ADC, 0);
+}
+
+
+static uint64_t hostNextEvent(void) {
+  uint64_t next = hostEndCycles;
+  uint64_t candidate;
+  uint8_t  i;
+
+  hostAdcStart();
+  hostUartCheck();
+
+  for (i = 0; i < 3; i++) {
+    candidate = timerNext(&hostTimers[i]);
+    if (candidate < next) next = candidate;
+  }
+  if (HAL_HOST_POWERDOWN != halHostSleepState && hostSpiDoneAt < next) next = hostSpiDoneAt;
+  if (HAL_HOST_POWERDOWN != halHostSleepState && hostTwiDoneAt < next) next = hostTwiDoneAt;
+  if (hostEepromDoneAt < next) next = hostEepromDoneAt;  // Finishes even in the power-down
+  if (HAL_HOST_POWERDOWN != halHostSleepState && hostAdcDoneAt < next) next = hostAdcDoneAt;
+  if (HAL_HOST_POWERDOWN != halHostSleepState && hostUartShiftedAt < next) next = hostUartShiftedAt;
+  for (i = 0; i < hostSources; i++) {
+    candidate = hostSourceNext[i]();
+    if (candidate < next) next = candidate;
+  }
+  return (next < halHostCycles) ? halHostCycles : next;
+}
+
+
+// The PRR has no write hook either, the clocked modules are compared after each step. Nothing
+// is clocked in the power-down, the clk_io is stopped.
+static void hostClocksCheck(void) {
+  uint8_t clocked = (HAL_HOST_POWERDOWN == halHostSleepState) ? 0 : (uint8_t)~PRR;
+
+  if (clocked == hostClocked) return;
+  hostClocked = clocked;
+  halHostActivity(HAL_HOST_ACTIVITY_CLOCKS, clocked);
+}
+
+
+// Move the clock to the `next` cycle, which must not be past the next event
+static void hostStep(uint64_t next) {
+  uint64_t cycles = next - halHostCycles;
+  uint8_t  i;
+
+  for (i = 0; i < 3; i++) timerAdvance(&hostTimers[i], cycles);
+  halHostStateCycles[halHostSleepState] += cycles;
+  halHostCycles = next;
+
+  if (hostSpiDoneAt <= halHostCycles) hostSpiFire();
+  if (hostTwiDoneAt <= halHostCycles) hostTwiFire();
+  if (hostEepromDoneAt <= halHostCycles) hostEepromFire();
+  if (hostAdcDoneAt <= halHostCycles) hostAdcFire();
+  if (hostUartShiftedAt <= halHostCycles) hostUartFire();
+  for (i = 0; i < hostSources; i++) {
+    if (hostSourceNext[i]() <= halHostCycles) hostSourceFire[i]();
+  }
+  hostClocksCheck();
+  if (halHostCycles >= hostEndCycles) longjmp(hostEnd, 1);
+}
+
+
+static int8_t hostPendingVector(uint8_t wakeUpOnly) {
+  uint8_t i;
+
+  for (i = 0; i < HOST_VECTORS; i++) {
+    hostVector *vector = &hostVectors[i];
+    if (!(*vector->flagReg   & (1 << vector->flagBit)))   continue;
+    if (!(*vector->enableReg & (1 << vector->enableBit))) continue;
+    if (wakeUpOnly && !vector->wakesPowerDown)            continue;
+    return i;
+  }
+  return -1;
+}
+
+
+static void hostDispatch(void) {
+  int8_t index;
+
+  while (hostInterruptsEnabled && (index = hostPendingVector(0)) >= 0) {
+    hostVector *vector = &hostVectors[index];
+
+    if (vector->clearedOnEntry) *vector->flagReg &= ~(1 << vector->flagBit);
+    hostInterruptsEnabled  = 0;
+    halHostIsrCount++;
+    halHostCharge(HOST_ISR_ENTRY_CYCLES);
+    hostInIsr = 1;
+    if (vector->isr) vector->isr();
+    hostInIsr = 0;
+    halHostCharge(HOST_ISR_EXIT_CYCLES);
+    hostInterruptsEnabled  = 1;
+  }
+}
+
+
+// Every path of the firmware which does something ends up here, so it's where the stack is sampled
+static void hostStackSample(void) {
+  uint32_t depth = hostStackTop - (uintptr_t)__builtin_frame_address(0);
+
+  if (depth <= halHostStackDeepest) return;
+  halHostStackDeepest      = depth;
+  halHostStackDeepestAt    = halHostCycles;
+  halHostStackDeepestInIsr = hostInIsr;
+}
+
+
+void halHostCharge(uint32_t cycles) {
+  uint64_t target = halHostCycles + cycles;
+
+  hostStackSample();
+  while (halHostCycles < target) {
+    uint64_t next = hostNextEvent();
+    hostStep((next < target) ? next : target);
+    hostDispatch();
+  }
+}
+
+
+static void hostSleep(uint8_t state) {
+  uint8_t wakeUpOnly = (HAL_HOST_POWERDOWN == state);
+
+  if (!hostSleepEnabled) return;
+  halHostSleepState = state;
+  halHostActivity(HAL_HOST_ACTIVITY_SLEEP, state);
+  hostClocksCheck();
+  while (hostPendingVector(wakeUpOnly) < 0 || !hostInterruptsEnabled) {
+    hostStep(hostNextEvent());
+  }
+  halHostSleepState = HAL_HOST_ACTIVE;
+  halHostActivity(HAL_HOST_ACTIVITY_SLEEP, HAL_HOST_ACTIVE);
+  if (wakeUpOnly) {
+    hostWokeAt = halHostCycles;
+    halHostCharge(HOST_WAKEUP_CYCLES);
+  }
+  hostDispatch();
+}
+
+
+void halHostRun(uint64_t endCycles) {
+  hostEndCycles = endCycles;
+  PIND = PINC = PINB = 0xFF;           // Everything is pulled up until a device drives the pins
+  SPSR = 0;
+  hostStackTop = (uintptr_t)__builtin_frame_address(0);
+  if (!setjmp(hostEnd)) {
+    firmwareMain();
+  }
+}
+
+
+// -------- CPU and peripherals --------
+
+void halHostCli(void) {
+  hostInterruptsEnabled = 0;
+}
+
+
+void halHostSei(void) {
+  hostInterruptsEnabled = 1;
+  hostDispatch();
+}
+
+
+uint8_t halHostInterruptsSave(void) {
+  return hostInterruptsEnabled;
+}
+
+
+void halHostInterruptsRestore(uint8_t state) {
+  if (state) halHostSei(); else halHostCli();
+}
+
+
+void halHostSpiWrite(uint8_t data) {
+  static const uint8_t dividers[4] = { 4, 16, 64, 128 };
+  uint32_t shiftCycles;
+
+  if (!(SPCR & (1 << SPE)) || (PRR & (1 << PRSPI))) return;  // Disabled or not clocked, nothing is shifted
+  if (HAL_HOST_NEVER != hostSpiDoneAt) {                    // The byte being shifted goes on, the write is lost
+    SPSR |= (1 << WCOL);
+    halHostSpiCollisions++;
+    halHostCharge(1);
+    return;
+  }
+  shiftCycles = 8 * dividers[SPCR & 0x03];
+  if (SPSR & (1 << SPI2X)) shiftCycles /= 2;
+
+  SPSR          &= ~(1 << SPIF);       // Writing SPDR after the ISR read the SPSR clears the flag
+  hostSpiData    = data;
+  hostSpiDoneAt  = halHostCycles + shiftCycles;
+  halHostActivity(HAL_HOST_ACTIVITY_SPI, 1);
+  SPDR           = data;
+  halHostCharge(1);
+}
+
+
+// 8N1 frames only, the start bit, 8 data bits and a stop bit
+uint32_t halHostUartFrameCycles(void) {
+  return 10 * ((UCSR0A & (1 << U2X0)) ? 8 : 16) * ((uint32_t)UBRR0 + 1);
+}
+
+
+// Writing the UDR0 goes straight to the shift register when it's empty, otherwise it waits in the buffer
+void halHostUartWrite(uint8_t data) {
+  if (!(UCSR0B & (1 << TXEN0)) || (PRR & (1 << PRUSART0))) return;
+  if (HAL_HOST_NEVER == hostUartShiftedAt) {
+    hostUartShifting  = data;
+    hostUartShiftedAt = halHostCycles + halHostUartFrameCycles();
+  } else if (!hostUartBuffered) {
+    hostUartBuffered  = 1;
+    hostUartNext      = data;
+    UCSR0A           &= ~(1 << UDRE0);
+  }
+  UCSR0A &= ~(1 << TXC0);
+  halHostCharge(1);
+}
+
+
+// A byte's stop bit arrived on the RXD, it's lost without the receiver's clock (the power-down
+// included), also when its start bit came before the clock, the receiver then locks onto one of its
+// data bits and the frame error drops it. The single byte buffer overruns when the previous byte was not read yet.
+void halHostUartReceive(uint8_t data) {
+  if (!(UCSR0B & (1 << RXEN0)) || (PRR & (1 << PRUSART0)) || HAL_HOST_POWERDOWN == halHostSleepState) return;
+  if (halHostCycles - halHostUartFrameCycles() <= hostWokeAt) return;
+  if (UCSR0A & (1 << RXC0)) {
+    UCSR0A |= (1 << DOR0);
+    return;
+  }
+  UDR0    = data;
+  UCSR0A  = (UCSR0A & ~((1 << FE0) | (1 << DOR0))) | (1 << RXC0);
+}
+
+
+// Writing the TWCR with the TWINT set starts the bus action selected by the other bits,
+// the TWINT is set again (and the IRQ requested) when the action finishes
+void halHostTwiControl(uint8_t value) {
+  static const uint8_t prescalers[4] = { 1, 4, 16, 64 };
+  uint32_t bitCycles = 16 + 2 * (uint32_t)TWBR * prescalers[TWSR & 0x03];
+  uint64_t startAt   = halHostCycles;
+  uint8_t  i;
+
+  if (PRR & (1 << PRTWI)) return;      // Not clocked, the registers can't be written
+  TWCR = (TWCR & (1 << TWINT)) | (value & ~((1 << TWINT) | (1 << TWSTO)));
+  if (!(value & (1 << TWEN))) {
+    // Disabling the module releases the bus immediately
+    if (hostTwiTaken) halHostActivity(HAL_HOST_ACTIVITY_TWI, 0);
+    hostTwiTaken  = 0;
+    hostTwiDoneAt = HAL_HOST_NEVER;
+    TWCR         &= ~(1 << TWINT);
+    return;
+  }
+  if (!(value & (1 << TWINT))) return;      // Writing 0 doesn't clear the flag, nothing starts
+  TWCR            &= ~(1 << TWINT);
+  hostTwiReceived  = 0;
+
+  if (value & (1 << TWSTO)) {
+    if (hostTwiTaken) {
+      halHostTwiBusCycles += halHostCycles + bitCycles - hostTwiTakenAt;
+      halHostActivity(HAL_HOST_ACTIVITY_TWI, 0);
+    }
+    hostTwiTaken  = 0;
+    hostTwiSlave  = NULL;
+    hostTwiDoneAt = HAL_HOST_NEVER;         // The stop doesn't set the TWINT
+    startAt      += bitCycles;
+  }
+
+  if (value & (1 << TWSTA)) {
+    hostTwiStatus      = hostTwiTaken ? 0x10 : 0x08;
+    hostTwiAddressNext = 1;
+    hostTwiDoneAt      = startAt + bitCycles;
+    if (!hostTwiTaken) {
+      halHostTwiTransactions++;
+      hostTwiTakenAt = startAt;
+      halHostActivity(HAL_HOST_ACTIVITY_TWI, 1);
+    }
+    hostTwiTaken       = 1;
+    return;
+  }
+  if (!hostTwiTaken) return;
+
+  // Everything else shifts 8 bits and the acknowledge bit
+  hostTwiDoneAt = halHostCycles + 9 * bitCycles;
+  if (hostTwiAddressNext) {
+    hostTwiAddressNext = 0;
+    hostTwiReading     = TWDR & 0x01;
+    hostTwiSlave       = NULL;
+    for (i = 0; i < hostTwiDeviceCount; i++) {
+      if (hostTwiDevices[i]->address == (TWDR >> 1)) hostTwiSlave = hostTwiDevices[i];
+    }
+    if (hostTwiSlave) hostTwiSlave->start(hostTwiReading);
+    hostTwiStatus      = hostTwiReading ? (hostTwiSlave ? 0x40 : 0x48) : (hostTwiSlave ? 0x18 : 0x20);
+  } else if (!hostTwiSlave) {
+    hostTwiStatus      = 0x00;              // Bus error, nobody should be talking
+  } else if (hostTwiReading) {
+    hostTwiData        = hostTwiSlave->read();
+    hostTwiReceived    = 1;
+    hostTwiStatus      = (value & (1 << TWEA)) ? 0x50 : 0x58;
+  } else {
+    hostTwiStatus      = hostTwiSlave->write(TWDR) ? 0x28 : 0x30;
+  }
+}
+
+
+void halHostAddTwiDevice(const halHostTwiDevice *device) {
+  if (hostTwiDeviceCount < HOST_MAX_TWI_DEVICES) hostTwiDevices[hostTwiDeviceCount++] = device;
+}
+
+
+void halHostWs2812bBit(uint8_t highCycles, uint8_t bitCycles) {
+  ws2812bPulse(halHostCycles, highCycles);
+  halHostCharge(bitCycles);
+}
+
+
+void halHostPinWrite(uint8_t port, uint8_t pin, uint8_t level) {
+  volatile uint8_t *ports[3] = { &PORTB, &PORTC, &PORTD };
+  uint8_t i;
+
+  if (level) *ports[port] |= (1 << pin); else *ports[port] &= ~(1 << pin);
+  for (i = 0; i < hostPinObserverCount; i++) hostPinObservers[i](port, pin, level);
+  halHostCharge(HOST_PIN_CYCLES);
+}
+
+
+void halHostPinInput(uint8_t port, uint8_t pin, uint8_t level) {
+  volatile uint8_t *pins[3]  = { &PINB,   &PINC,   &PIND   };
+  volatile uint8_t *masks[3] = { &PCMSK0, &PCMSK1, &PCMSK2 };
+  uint8_t before             = *pins[port];
+
+  if (level) *pins[port] |= (1 << pin); else *pins[port] &= ~(1 << pin);
+  if ((before ^ *pins[port]) & *masks[port]) PCIFR |= (1 << port); // PCIF0-2 match the port order B, C, D
+}
+
+
+// -------- CodeVisionAVR library stand-ins --------
+
+void delay_us(unsigned int us) {
+  halHostCharge(HAL_HOST_US(us));
+}
+
+
+void delay_ms(unsigned int ms) {
+  halHostCharge(HAL_HOST_MS(ms));
+}
+
+
+void sleep_enable(void) {
+  hostSleepEnabled = 1;
+}
+
+
+// Only the atomic erase and write mode (EEPM bits 0) is simulated, a write while the previous
+// one is in progress is ignored just like the EEPE is on the chip
+void halHostEepromWrite(void) {
+  if (EECR & (1 << EEPE)) return;
+  halHostEeprom[EEAR % HAL_HOST_EEPROM_SIZE] = EEDR;
+  halHostEepromWrites++;
+  EECR             |= (1 << EEPE);
+  hostEepromReady   = 0;
+  hostEepromDoneAt  = halHostCycles + HOST_EEPROM_WRITE_CYCLES;
+  halHostCharge(HOST_PIN_CYCLES);
+}
+
+
+void halHostEepromRead(void) {
+  EEDR = halHostEeprom[EEAR % HAL_HOST_EEPROM_SIZE];
+  halHostCharge(4);                    // The CPU is halted for 4 cycles
+}
+
+
+void sleep_disable(void) {
+  hostSleepEnabled = 0;
+}
+
+
+void idle(void) {
+  hostSleep(HAL_HOST_IDLE);
+}
+
+
+void powerdown(void) {
+  hostSleep(HAL_HOST_POWERDOWN);
+}
+
+
+// The pending IRQs are served only after the sleep, it returns right away when there's one
+void halHostSleepIdle(void) {
+  hostInterruptsEnabled = 1;
+  hostSleep(HAL_HOST_IDLE);
+  hostDispatch();
+}
+
+
+// The BODS timed sequence is not simulated, only its effect
+void halHostPowerDownNoBod(void) {
+  halHostActivity(HAL_HOST_ACTIVITY_BOD, 0);
+  hostSleep(HAL_HOST_POWERDOWN);
+  halHostActivity(HAL_HOST_ACTIVITY_BOD, 1);
+  halHostCharge(HOST_BOD_WAKEUP_CYCLES);
+}
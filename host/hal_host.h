@@ -0,0 +1,153 @@
+#ifndef SMARTWATCH_HOST_HAL_HOST_H
+#define SMARTWATCH_HOST_HAL_HOST_H
+
+#include <stdint.h>
+
+#include "avr_regs.h"
+
+
+// Host (Linux + GCC) backend of the hal.h seam. The firmware runs unmodified against
+// a virtual clock counting the 8MHz CPU cycles. The clock moves forward only when
+// the firmware spends time (delays, SPI/TWI transfers, sleeping), on each step the
+// timers are updated, the simulated devices can react and the pending IRQs are
+// dispatched to the firmware's ISR functions.
+
+typedef uint8_t bit;           // CodeVisionAVR 1-bit global variables
+#define flash const            // CodeVisionAVR flash memory qualifier
+
+
+#define HAL_HOST_F_CPU         8000000UL
+#define HAL_F_CPU              HAL_HOST_F_CPU
+#define HAL_HOST_NEVER         UINT64_MAX
+#define HAL_HOST_US(us)        ((uint64_t)(us) * (HAL_HOST_F_CPU / 1000000UL))
+#define HAL_HOST_MS(ms)        ((uint64_t)(ms) * (HAL_HOST_F_CPU / 1000UL))
+#define HAL_HOST_S(s)          ((uint64_t)(s)  * HAL_HOST_F_CPU)
+
+#define HAL_HOST_EEPROM_SIZE   512
+
+#define HAL_HOST_PORT_B        0
+#define HAL_HOST_PORT_C        1
+#define HAL_HOST_PORT_D        2
+
+#define HAL_HOST_ACTIVE        0
+#define HAL_HOST_IDLE          1
+#define HAL_HOST_POWERDOWN     2
+
+// What the CPU and the devices are doing, reported to the activity observers (energy accounting...)
+#define HAL_HOST_ACTIVITY_SLEEP    0 // HAL_HOST_ACTIVE/IDLE/POWERDOWN
+#define HAL_HOST_ACTIVITY_SPI      1 // 1 while shifting a byte
+#define HAL_HOST_ACTIVITY_TWI      2 // 1 while a TWI transaction is in progress
+#define HAL_HOST_ACTIVITY_VFD      3 // How many segments are glowing
+#define HAL_HOST_ACTIVITY_NEOPIXEL 4 // Sum of all colour channels of all LEDs (0-255 each)
+#define HAL_HOST_ACTIVITY_ADC      5 // 1 while converting
+#define HAL_HOST_ACTIVITY_CLOCKS   6 // Modules with the clock enabled (inverted PRR bits), 0 in the power-down
+#define HAL_HOST_ACTIVITY_BOD      7 // 0 while the BOD is disabled by the BODS
+
+
+// -------- hal.h seam --------
+#define HAL_ISR(vector)
+#define halInterruptsDisable() halHostCli()
+#define halInterruptsEnable()  halHostSei()
+#define halInterruptsSave()    halHostInterruptsSave()
+#define halInterruptsRestore(state) halHostInterruptsRestore(state)
+#define halPinHigh(port, pin)  halHostPinWrite(HAL_HOST_PORT_##port, pin, 1)
+#define halPinLow(port, pin)   halHostPinWrite(HAL_HOST_PORT_##port, pin, 0)
+#define halPinRead(port, pin)  (PIN##port & (1 << (pin)))
+#define halSpiWrite(data)      halHostSpiWrite(data)
+#define halUartWrite(data)     halHostUartWrite(data)
+#define halTwiControl(value)   halHostTwiControl(value)
+#define halEepromWrite()       halHostEepromWrite()
+#define halEepromRead()        halHostEepromRead()
+#define halFlagClear(reg, flag) reg &= ~(1 << (flag))
+#define halSleepIdle()         halHostSleepIdle()
+#define halPowerDown()         halHostPowerDownNoBod()
+#define HAL_DATA_STACK_SIZE    128
+#define HAL_HW_STACK_SIZE      64
+#define halDataStack()         halHostDataStack
+#define halHwStack()           halHostHwStack
+#define halHwStackPointer()    (halHostHwStack + HAL_HW_STACK_SIZE - 3)   // The main()'s and the stackPaint's return addresses
+
+
+// -------- Virtual clock --------
+extern uint64_t halHostCycles;                                     // CPU cycles since the reset
+extern uint8_t  halHostSleepState;                                 // HAL_HOST_ACTIVE/IDLE/POWERDOWN
+extern uint64_t halHostStateCycles[3];                             // Time spent in each of the sleep states
+extern uint32_t halHostIsrCount;                                   // How many IRQs were serviced
+
+extern void halHostRun(uint64_t endCycles);                        // Run the firmware's main() until the endCycles
+extern void halHostCharge(uint32_t cycles);                        // Firmware spent time, IRQs can happen meanwhile
+
+// Simulated devices register their events, `next` returns the absolute cycle of the next event
+// (or HAL_HOST_NEVER) and `fire` is called when the clock reaches it
+extern void halHostAddSource(uint64_t (*next)(void), void (*fire)(void));
+
+
+// -------- CPU and peripherals --------
+extern void halHostCli(void);
+extern void halHostSei(void);
+extern uint8_t halHostInterruptsSave(void);                           // Stand-in for the SREG's I bit
+extern void halHostInterruptsRestore(uint8_t state);
+extern uint32_t halHostSpiCollisions;                              // SPDR writes ignored while a byte was shifting (WCOL)
+extern void halHostSpiWrite(uint8_t data);
+extern void halHostUartWrite(uint8_t data);                           // UDR0 write
+extern void halHostUartReceive(uint8_t data);                         // A device sent a byte to the RXD0
+extern uint32_t halHostUartFrameCycles(void);                         // One byte at the baud rate in the UBRR0
+extern void halHostTwiControl(uint8_t value);
+extern void halHostEepromWrite(void);                                 // EEDR to the EEAR, busy for 3.4ms
+extern void halHostEepromRead(void);                                  // EEAR to the EEDR
+extern void halHostWs2812bBit(uint8_t highCycles, uint8_t bitCycles); // One bit on the Neopixel PB2
+extern void halHostPinWrite(uint8_t port, uint8_t pin, uint8_t level);   // Firmware drives an output
+extern void halHostPinInput(uint8_t port, uint8_t pin, uint8_t level);   // A device drives an input
+
+extern void halHostOnPinWrite(void (*observer)(uint8_t port, uint8_t pin, uint8_t level));
+extern void halHostOnSpiByte(void (*observer)(uint8_t data));
+extern void halHostOnUartByte(void (*observer)(uint8_t data));         // Byte transmitted on the TXD0
+extern void halHostActivity(uint8_t what, uint32_t level);
+extern void halHostOnActivity(void (*observer)(uint8_t what, uint32_t level));
+
+
+// -------- TWI bus --------
+// A slave device on the TWI bus, the master is the firmware driving the TWI module
+typedef struct {
+  uint8_t   address;                 // 7-bit address
+  void    (*start)(uint8_t read);    // Addressed after a (repeated) start condition
+  uint8_t (*write)(uint8_t data);    // Byte from the master, returns 1 to acknowledge it
+  uint8_t (*read)(void);             // Byte to the master
+} halHostTwiDevice;
+
+extern uint32_t halHostTwiTransactions;                            // Start conditions which took the bus
+extern uint64_t halHostTwiBusCycles;                               // How long the bus was taken
+
+extern void halHostAddTwiDevice(const halHostTwiDevice *device);
+
+
+// -------- EEPROM --------
+extern uint8_t  halHostEeprom[HAL_HOST_EEPROM_SIZE];                // Content, the simulator can load and save it
+extern uint32_t halHostEepromWrites;                                // Bytes written (each one wears a cell and takes 3.4ms)
+
+
+// -------- Stacks --------
+// The firmware runs on the host's stack, the AVR's stacks are stand-ins which stay painted. The depth
+// of the host's stack is sampled whenever the firmware spends time instead, the absolute numbers are
+// the x86-64 frames (several times the AVR's), but they show which path is the deepest and when it grew.
+extern uint8_t  halHostDataStack[HAL_DATA_STACK_SIZE];
+extern uint8_t  halHostHwStack[HAL_HW_STACK_SIZE];
+extern uint32_t halHostStackDeepest;                                // Bytes below the halHostRun's frame
+extern uint64_t halHostStackDeepestAt;                              // Cycle when it was reached
+extern uint8_t  halHostStackDeepestInIsr;                           // 1 when an ISR was being serviced then
+
+
+// -------- ADC --------
+extern uint16_t halHostBatteryMillivolts;                           // VCC, the 1.1V bandgap is converted against it
+
+
+// -------- CodeVisionAVR library stand-ins --------
+extern void delay_us(unsigned int us);
+extern void delay_ms(unsigned int ms);
+extern void sleep_enable(void);
+extern void sleep_disable(void);
+extern void idle(void);
+extern void powerdown(void);
+extern void halHostSleepIdle(void);                                   // SEI+SLEEP, nothing served in between
+extern void halHostPowerDownNoBod(void);                              // The power-down with the BOD off
+#endif
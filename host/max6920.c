@@ -0,0 +1,129 @@
+#include <stdint.h>
+
+#include "../hal.h"
+#include "../vfd.h"
+#include "../font.h"
+#include "max6920.h"
+
+
+#define MAX6920_PERSISTENCE HAL_HOST_MS(5) // A grid not refreshed for this long counts as blank
+
+#define MAX6920_OUTPUTS     ((1ULL << DISPLAY_DRIVER_BITS) - 1)
+
+#define DISPLAY_GRID(output, trim, text) output,
+static const uint8_t max6920GridBits[VFD_GRIDS] = { DISPLAY_GRID_LIST };
+#undef  DISPLAY_GRID
+
+#define DISPLAY_GRID(output, trim, text) | (1UL << (output))
+static const uint32_t max6920GridMask = 0 DISPLAY_GRID_LIST;   // All the grid selectors
+#undef  DISPLAY_GRID
+
+max6920Grid max6920Grids[VFD_GRIDS];
+uint64_t    max6920PoweredCycles = 0;
+
+static uint32_t max6920Shift     = 0;  // Shift register, bits above the DISPLAY_DRIVER_BITS fall out
+static uint32_t max6920Latch     = 0;  // What the driver stage outputs
+static uint8_t  max6920Powered   = 0;  // DC2DC on PD4
+static uint8_t  max6920LoadLevel = 0;
+static uint64_t max6920Since     = 0;  // When the latch or the power changed last time
+
+static uint32_t max6920Segments[VFD_GRIDS]; // Last segments latched for each grid
+static uint64_t max6920SeenAt[VFD_GRIDS];
+
+
+// How many segments glow with the current latch and power
+static uint8_t max6920SegmentsLit(void) {
+  uint32_t segments = max6920Latch & ~max6920GridMask;
+  uint8_t  grids    = (max6920Latch != segments);   // Any grid selected at all
+  uint8_t  lit      = 0;
+
+  if (!max6920Powered || !grids) return 0;
+  if (!DISPLAY_COLON_SEGMENTS && (max6920Latch & (1UL << DISPLAY_CH_COLON))) lit++; // The ':' has no segments, the grid itself glows
+  for (; segments; segments >>= 1) lit += segments & 1;
+  return lit;
+}
+
+
+// Account the glowing time of the state which is ending now
+static void max6920Account(void) {
+  uint64_t elapsed = halHostCycles - max6920Since;
+  uint8_t  i;
+
+  if (max6920Powered) {
+    max6920PoweredCycles += elapsed;
+    for (i = 0; i < VFD_GRIDS; i++) {
+      if (max6920Latch & (1UL << max6920GridBits[i])) max6920Grids[i].litCycles += elapsed;
+    }
+  }
+  max6920Since = halHostCycles;
+}
+
+
+static void max6920OnSpiByte(uint8_t data) {
+  max6920Shift = ((max6920Shift << 8) | data) & MAX6920_OUTPUTS;
+}
+
+
+static void max6920OnPinWrite(uint8_t port, uint8_t pin, uint8_t level) {
+  uint8_t i;
+
+  if (HAL_HOST_PORT_D == port && 4 == pin && level != max6920Powered) {
+    max6920Account();
+    max6920Powered = level;
+    halHostActivity(HAL_HOST_ACTIVITY_VFD, max6920SegmentsLit());
+  }
+
+  if (HAL_HOST_PORT_D == port && 7 == pin) {
+    if (level && !max6920LoadLevel) {
+      // Rising edge of the LOAD, the shift register goes to the outputs
+      max6920Account();
+      max6920Latch = max6920Shift;
+      halHostActivity(HAL_HOST_ACTIVITY_VFD, max6920SegmentsLit());
+      for (i = 0; i < VFD_GRIDS; i++) {
+        if (max6920Latch & (1UL << max6920GridBits[i])) {
+          max6920Grids[i].loads++;
+          max6920Segments[i] = max6920Latch & ~max6920GridMask;
+          max6920SeenAt[i]   = halHostCycles;
+        }
+      }
+    }
+    max6920LoadLevel = level;
+  }
+}
+
+
+void max6920Init(void) {
+  halHostOnSpiByte(max6920OnSpiByte);
+  halHostOnPinWrite(max6920OnPinWrite);
+}
+
+
+uint8_t max6920GridOutput(uint8_t grid) {
+  return max6920GridBits[grid];
+}
+
+
+void max6920Text(char *text) {
+  uint8_t i, glyph;
+
+  max6920Account();
+  for (i = 0; i < VFD_GRIDS; i++) {
+    uint8_t visible = max6920Powered && max6920Grids[i].loads &&
+                      (halHostCycles - max6920SeenAt[i]) < MAX6920_PERSISTENCE;
+    char    shown   = ' ';
+
+    if (visible && DISPLAY_POS_COLON == i && DISPLAY_COLON_SEGMENTS == max6920Segments[i]) {
+      shown = ':';
+    } else if (visible) {
+      shown = '?';
+      for (glyph = 0; glyph < FONT_CHARS; glyph++) {
+        if (fontAscii[glyph] == max6920Segments[i]) {
+          shown = FONT_FIRST_CHAR + glyph;
+          break;
+        }
+      }
+    }
+    text[i] = shown;
+  }
+  text[VFD_GRIDS] = 0;
+}
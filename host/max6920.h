@@ -0,0 +1,24 @@
+#ifndef SMARTWATCH_HOST_MAX6920_H
+#define SMARTWATCH_HOST_MAX6920_H
+
+#include <stdint.h>
+
+#include "../display.h"
+
+// MAX6920AWP 12-bit shift register with latches driving the IVL2-7/5 VFD (or the wider
+// driver and the tube of the display.h), clocked by the SPI (PB3/PB5) and latched by
+// the LOAD pulse on PD7
+
+typedef struct {
+  uint32_t loads;        // How many times a word selecting this grid was latched
+  uint64_t litCycles;    // How long the grid was glowing (DC2DC on and the grid selected)
+} max6920Grid;
+
+extern max6920Grid max6920Grids[DISPLAY_GRIDS]; // In the refresh order
+extern uint64_t    max6920PoweredCycles;        // How long the DC2DC was on
+
+extern void    max6920Init(void);
+extern void    max6920Text(char *text);         // What a person would see now, "HH:MM" with blanks and '?' for unknown glyphs (DISPLAY_GRIDS characters)
+extern uint8_t max6920GridOutput(uint8_t grid); // Driver output selecting a grid
+
+#endif
@@ -0,0 +1,131 @@
+#define _XOPEN_SOURCE 600   // posix_openpt
+#define _DEFAULT_SOURCE     // cfmakeraw
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "hal_host.h"
+#include "serial.h"
+
+
+#define SERIAL_POLL HAL_HOST_MS(1)   // How often the pty is read and the simulation paced
+
+typedef struct {
+  uint64_t at;
+  uint8_t  data;
+} serialByte;
+
+static serialByte serialQueue[SERIAL_QUEUE];
+static uint16_t   serialHead      = 0;
+static uint16_t   serialTail      = 0;
+static uint64_t   serialLastAt    = 0;            // The script has to be in time order
+static uint64_t   serialStopAt    = HAL_HOST_NEVER; // Stop bit of the byte on the line
+static uint8_t    serialSending   = 0;
+static int        serialMaster    = -1;           // The pty, -1 without it
+static uint64_t   serialPollAt    = HAL_HOST_NEVER;
+static struct timespec serialStart;               // Real time of the cycle 0
+static void     (*serialTransmitted)(uint8_t data);
+
+
+static uint8_t serialPut(uint64_t at, uint8_t data) {
+  uint16_t next = (serialHead + 1) % SERIAL_QUEUE;
+
+  if (next == serialTail) return 0;
+  serialQueue[serialHead].at   = at;
+  serialQueue[serialHead].data = data;
+  serialHead                   = next;
+  return 1;
+}
+
+
+uint8_t serialAdd(uint64_t atCycles, const uint8_t *data, uint16_t length) {
+  uint16_t i;
+
+  if (atCycles < serialLastAt) return 0;
+  serialLastAt = atCycles;
+  for (i = 0; i < length; i++) {
+    if (!serialPut(atCycles, data[i])) return 0;
+  }
+  return 1;
+}
+
+
+const char *serialPty(void) {
+  struct termios mode;
+
+  serialMaster = posix_openpt(O_RDWR | O_NOCTTY);
+  if (serialMaster < 0 || grantpt(serialMaster) || unlockpt(serialMaster)) return NULL;
+  tcgetattr(serialMaster, &mode);
+  cfmakeraw(&mode);                               // Binary frames, no echo and no line editing
+  tcsetattr(serialMaster, TCSANOW, &mode);
+  fcntl(serialMaster, F_SETFL, O_NONBLOCK);
+  clock_gettime(CLOCK_MONOTONIC, &serialStart);
+  serialPollAt = 0;
+  return ptsname(serialMaster);
+}
+
+
+// Don't let the virtual clock run ahead of the real one, then take what the program wrote
+static void serialPoll(void) {
+  struct timespec now, wait;
+  uint8_t         data[64];
+  double          ahead;
+  ssize_t         count, i;
+
+  serialPollAt = halHostCycles + SERIAL_POLL;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  ahead = (double)halHostCycles / HAL_HOST_F_CPU - (now.tv_sec - serialStart.tv_sec) - (now.tv_nsec - serialStart.tv_nsec) / 1e9;
+  if (ahead > 0) {
+    wait.tv_sec  = (time_t)ahead;
+    wait.tv_nsec = (long)((ahead - wait.tv_sec) * 1e9);
+    nanosleep(&wait, NULL);
+  }
+
+  count = read(serialMaster, data, sizeof(data));
+  for (i = 0; i < count; i++) serialPut(halHostCycles, data[i]);
+}
+
+
+static uint64_t serialNext(void) {
+  uint64_t next = serialPollAt;
+
+  if (serialSending) return (serialStopAt < next) ? serialStopAt : next;
+  if (serialHead != serialTail && serialQueue[serialTail].at < next) next = serialQueue[serialTail].at;
+  return next;
+}
+
+
+static void serialFire(void) {
+  if (serialSending && serialStopAt <= halHostCycles) {
+    serialSending = 0;
+    serialStopAt  = HAL_HOST_NEVER;
+    halHostPinInput(HAL_HOST_PORT_D, 0, 1);
+    halHostUartReceive(serialQueue[serialTail].data);
+    serialTail    = (serialTail + 1) % SERIAL_QUEUE;
+  }
+  if (serialPollAt <= halHostCycles) serialPoll();
+  if (!serialSending && serialHead != serialTail && serialQueue[serialTail].at <= halHostCycles) {
+    serialSending = 1;
+    serialStopAt  = halHostCycles + halHostUartFrameCycles();
+    halHostPinInput(HAL_HOST_PORT_D, 0, 0);      // The start bit, the data bits are not modelled on the pin
+  }
+}
+
+
+static void serialOnByte(uint8_t data) {
+  if (serialMaster >= 0 && write(serialMaster, &data, 1) < 0) {
+    // Nobody has the pty open, the byte is lost just like on a disconnected wire
+  }
+  if (serialTransmitted) serialTransmitted(data);
+}
+
+
+void serialInit(void (*transmitted)(uint8_t data)) {
+  serialTransmitted = transmitted;
+  halHostAddSource(serialNext, serialFire);
+  halHostOnUartByte(serialOnByte);
+}
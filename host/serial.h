@@ -0,0 +1,18 @@
+#ifndef SMARTWATCH_HOST_SERIAL_H
+#define SMARTWATCH_HOST_SERIAL_H
+
+#include <stdint.h>
+
+// Host end of the watch's UART, the PD0 (RXD0) and the PD1 (TXD0). The bytes for the watch come
+// either from a script or from a pseudo terminal, which a program (like the watchctl) opens as
+// a serial port. With the pty the simulation is slowed down to the real time, so the program's
+// timeouts mean the same thing to both sides. Each byte pulls the PD0 low for its start bit,
+// that's what wakes the sleeping watch up.
+
+#define SERIAL_QUEUE 1024
+
+extern uint8_t     serialAdd(uint64_t atCycles, const uint8_t *data, uint16_t length); // Bytes sent back to back, not before the `atCycles`
+extern const char *serialPty(void);                                  // Open the pty, returns the name of its slave side (NULL on failure)
+extern void        serialInit(void (*transmitted)(uint8_t data));    // Every byte the firmware transmits is passed to the `transmitted`
+
+#endif
@@ -0,0 +1,276 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hal_host.h"
+#include "button.h"
+#include "ds3231.h"
+#include "max6920.h"
+#include "ws2812b.h"
+#include "serial.h"
+#include "input.h"      // The firmware's press to display latency counters
+#include "battery.h"    // What the firmware measured
+#include "vfd.h"        // The firmware's wake-up latency counters
+#include "uart.h"       // The command channel's frame format
+#include "profile.h"    // The firmware's region statistics, when built with the PROFILE
+#include "thermal.h"    // The temperature the firmware compensated for
+
+
+// Runs the firmware against the simulated watch and prints what a person would see:
+//
+//   ./sim -s 60 -p 20000:300 -p 30000:2500
+//
+//   -s seconds       how long to run (virtual time), default 30
+//   -p at_ms:hold_ms press the WAKE-UP button at `at_ms` for `hold_ms`, can be repeated
+//   -t HH:MM:SS      time in the RTC before the firmware starts
+//   -o               the RTC lost its time (oscillator stop flag set), the firmware has to use its own
+//   -e file          EEPROM content, loaded before the start (when it exists) and saved at the end
+//   -b millivolts    battery voltage, default 3900
+//   -T celsius       temperature measured by the DS3231, default 25
+//   -A HH:MM         alarm set in the RTC before the firmware starts
+//   -x at_ms:frame   send a command frame over the UART at `at_ms`, the frame is the command letter
+//                    followed by decimal bytes (T,8,30,0) or by a text (M=HELO), can be repeated
+//   -u               open a pty as the host end of the UART and run in the real time (see the watchctl)
+
+#define SIM_SAMPLE_PERIOD HAL_HOST_MS(10)
+
+static uint64_t simNextSample = 0;
+static char     simShown[DISPLAY_GRIDS + 1];  // The colon is kept from the first sample, it must not be the terminator
+
+
+static double simSeconds(uint64_t cycles) {
+  return (double)cycles / HAL_HOST_F_CPU;
+}
+
+
+static uint64_t simSampleNext(void) {
+  return simNextSample;
+}
+
+
+// Print the display only when the digits change, the blinking ':' is ignored
+static void simSample(void) {
+  char text[DISPLAY_GRIDS + 1];
+
+  simNextSample += SIM_SAMPLE_PERIOD;
+  max6920Text(text);
+  text[DISPLAY_POS_COLON] = simShown[DISPLAY_POS_COLON];
+  if (strcmp(text, simShown)) {
+    memcpy(simShown, text, sizeof(simShown));
+    max6920Text(text);
+    printf("%10.3fs  VFD '%s'\n", simSeconds(halHostCycles), text);
+  }
+}
+
+
+// Only the start of a buzz is printed, not each of its pulses, the pulses are counted in the report
+#define SIM_MOTOR_QUIET HAL_HOST_S(1)
+
+static uint8_t  simMotorOn      = 0;
+static uint64_t simMotorSince   = 0;   // Last switch on or off
+static uint64_t simMotorCycles  = 0;   // Time spent spinning
+static unsigned simMotorPulses  = 0;
+
+
+static void simMotor(uint8_t port, uint8_t pin, uint8_t level) {
+  if (HAL_HOST_PORT_D != port || 5 != pin || level == simMotorOn) return;
+  if (level) {
+    if (!simMotorPulses || halHostCycles - simMotorSince > SIM_MOTOR_QUIET) {
+      printf("%10.3fs  MOTOR buzzing\n", simSeconds(halHostCycles));
+    }
+    simMotorPulses++;
+  } else {
+    simMotorCycles += halHostCycles - simMotorSince;
+  }
+  simMotorOn    = level;
+  simMotorSince = halHostCycles;
+}
+
+
+// Frames transmitted by the firmware are printed whole, the check is verified here
+static void simUart(uint8_t data) {
+  static uint8_t frame[UART_PAYLOAD_MAX + UART_OVERHEAD];
+  static uint8_t length = 0;
+  uint8_t        sum    = 0;
+  uint8_t        i;
+
+  if (0 == length && UART_SYNC != data) return;
+  frame[length++] = data;
+  if (length < 2 || length < frame[1] + UART_OVERHEAD) return;
+
+  printf("%10.3fs  UART '%c'", simSeconds(halHostCycles), frame[2]);
+  for (i = 3; i < length - 1; i++) printf(" %02X", frame[i]);
+  for (i = 1; i < length; i++) sum += frame[i];
+  printf("%s\n", sum ? " (bad check)" : "");
+  length = 0;
+}
+
+
+// "T,8,30,0" or "M=HELO" into a whole frame
+static uint16_t simFrame(const char *spec, uint8_t *frame) {
+  uint8_t length = 0;
+  uint8_t sum;
+  uint8_t i;
+
+  frame[2] = spec[0];
+  if ('=' == spec[1]) {
+    for (spec += 2; *spec && length < UART_PAYLOAD_MAX; spec++) frame[3 + length++] = *spec;
+  } else {
+    for (spec++; ',' == *spec && length < UART_PAYLOAD_MAX; length++) frame[3 + length] = strtoul(spec + 1, (char **)&spec, 10);
+  }
+  frame[0] = UART_SYNC;
+  frame[1] = length;
+  for (sum = 0, i = 1; i < length + 3; i++) sum += frame[i];
+  frame[3 + length] = -sum;
+  return length + UART_OVERHEAD;
+}
+
+
+static void simNeopixel(void) {
+  printf("%10.3fs  LED #%06X\n", simSeconds(halHostCycles), ws2812bColor[0]);
+}
+
+
+// The histogram's buckets are <4us, <16us ... <16ms, the rest
+static void simProfile(void) {
+#if PROFILE
+  static const char *names[PROFILE_REGIONS] = { PROFILE_NAMES };
+  uint8_t region, i;
+
+  printf("\n%-14s %6s %7s %7s   histogram\n", "Profile", "count", "min us", "max us");
+  for (region = 0; region < PROFILE_REGIONS; region++) {
+    profileRegion *stats = &profileRegions[region];
+
+    printf("%-14s %6u %7u %7u  ", names[region], stats->count,
+           stats->min * PROFILE_TICK_US, stats->max * PROFILE_TICK_US);
+    for (i = 0; i < PROFILE_BUCKETS; i++) printf(" %5u", stats->buckets[i]);
+    printf("\n");
+  }
+#endif
+}
+
+
+static void simReport(void) {
+  uint64_t powered = max6920PoweredCycles;
+  uint8_t  i;
+
+  printf("\n--- %.3fs simulated ---\n", simSeconds(halHostCycles));
+  printf("CPU active %.3fs, idle %.3fs, power-down %.3fs, %u IRQs\n",
+         simSeconds(halHostStateCycles[HAL_HOST_ACTIVE]),
+         simSeconds(halHostStateCycles[HAL_HOST_IDLE]),
+         simSeconds(halHostStateCycles[HAL_HOST_POWERDOWN]),
+         halHostIsrCount);
+  printf("VFD powered %.3fs\n", simSeconds(powered));
+  for (i = 0; i < DISPLAY_GRIDS && powered; i++) {
+    printf("  Grid %u (OUT%-2u) refresh %7.1f Hz, duty %5.2f%%\n", i + 1, max6920GridOutput(i),
+           max6920Grids[i].loads / simSeconds(powered),
+           100.0 * max6920Grids[i].litCycles / powered);
+  }
+  printf("SPI %u write collisions\n", halHostSpiCollisions);
+  printf("TWI %u transactions, bus busy %.3fs\n", halHostTwiTransactions, simSeconds(halHostTwiBusCycles));
+  printf("Neopixel %u frames\n", ws2812bFrames);
+  printf("EEPROM %u bytes written\n", halHostEepromWrites);
+  printf("Button to display latency %.3fms last, %.3fms worst (128us resolution)\n",
+         inputLatency * 1024000.0 / HAL_HOST_F_CPU, inputLatencyMax * 1024000.0 / HAL_HOST_F_CPU);
+  printf("Wake to the first frame %.3fms last, %.3fms worst\n",
+         vfdWakeLatency * 1024000.0 / HAL_HOST_F_CPU, vfdWakeLatencyMax * 1024000.0 / HAL_HOST_F_CPU);
+  printf("Motor %u pulses, spinning %.3fs\n", simMotorPulses, simSeconds(simMotorCycles));
+  printf("Battery %umV measured (level %u)\n", batteryMillivolts, batteryLevel);
+  printf("Temperature %dC read, filament duty %u/%u\n", thermalCelsius, vfdFilamentDuty, VFD_FILAMENT_STEPS);
+  printf("Host stack %u bytes deepest, at %.3fs %s\n", halHostStackDeepest,
+         simSeconds(halHostStackDeepestAt), halHostStackDeepestInIsr ? "in an ISR" : "in the super loop");
+  simProfile();
+}
+
+
+static void simEeprom(const char *path, uint8_t save) {
+  FILE *file = fopen(path, save ? "wb" : "rb");
+
+  if (!file) return;                   // Nothing saved yet, the EEPROM stays erased
+  if (save) fwrite(halHostEeprom, 1, HAL_HOST_EEPROM_SIZE, file);
+  else      fread(halHostEeprom, 1, HAL_HOST_EEPROM_SIZE, file);
+  fclose(file);
+}
+
+
+int main(int argc, char *argv[]) {
+  uint64_t    seconds = 30;
+  unsigned    h = 8, m = 0, s = 0;
+  uint8_t     lost    = 0;
+  const char *eeprom  = NULL;
+  unsigned    alarmHour = 24, alarmMinute = 0;
+  double      celsius = 25;
+  uint8_t     pty     = 0;
+  int         i;
+
+  for (i = 1; i < argc; i++) {
+    unsigned long at, hold;
+    int           offset = 0;
+
+    if (!strcmp(argv[i], "-s") && i + 1 < argc) {
+      seconds = strtoull(argv[++i], NULL, 10);
+    } else if (!strcmp(argv[i], "-p") && i + 1 < argc && 2 == sscanf(argv[++i], "%lu:%lu", &at, &hold)) {
+      if (!buttonAdd(HAL_HOST_MS(at), HAL_HOST_MS(hold))) {
+        fprintf(stderr, "sim: presses have to be in order and not overlap\n");
+        return 1;
+      }
+    } else if (!strcmp(argv[i], "-t") && i + 1 < argc && 3 == sscanf(argv[++i], "%u:%u:%u", &h, &m, &s)) {
+      // Parsed already
+    } else if (!strcmp(argv[i], "-o")) {
+      lost = 1;
+    } else if (!strcmp(argv[i], "-e") && i + 1 < argc) {
+      eeprom = argv[++i];
+    } else if (!strcmp(argv[i], "-b") && i + 1 < argc) {
+      halHostBatteryMillivolts = strtoul(argv[++i], NULL, 10);
+    } else if (!strcmp(argv[i], "-T") && i + 1 < argc) {
+      celsius = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "-A") && i + 1 < argc && 2 == sscanf(argv[++i], "%u:%u", &alarmHour, &alarmMinute)) {
+      // Parsed already
+    } else if (!strcmp(argv[i], "-x") && i + 1 < argc && 1 == sscanf(argv[++i], "%lu:%n", &at, &offset) && offset) {
+      uint8_t frame[UART_PAYLOAD_MAX + UART_OVERHEAD];
+
+      if (!serialAdd(HAL_HOST_MS(at), frame, simFrame(argv[i] + offset, frame))) {
+        fprintf(stderr, "sim: frames have to be in order\n");
+        return 1;
+      }
+    } else if (!strcmp(argv[i], "-u")) {
+      pty = 1;
+    } else {
+      fprintf(stderr, "usage: %s [-s seconds] [-t HH:MM:SS] [-o] [-e eeprom_file] [-b millivolts] [-T celsius] [-A HH:MM] [-u] [-x at_ms:frame]... [-p at_ms:hold_ms]...\n", argv[0]);
+      return 1;
+    }
+  }
+
+  if (eeprom) simEeprom(eeprom, 0);
+  ds3231Init(h * 3600 + m * 60 + s, lost);
+  ds3231Temperature(celsius);
+  if (alarmHour < 24) {
+    // Daily alarm 2 with the firmware's "on" tag in the date bits, as the firmware's alarmSet writes it
+    ds3231Write(0x0B, ((alarmMinute / 10) << 4) | (alarmMinute % 10));
+    ds3231Write(0x0C, ((alarmHour / 10) << 4) | (alarmHour % 10));
+    ds3231Write(0x0D, 0x81);
+  }
+  max6920Init();
+  memset(simShown, ' ', DISPLAY_GRIDS);
+  ws2812bInit(simNeopixel);
+  buttonInit();
+  halHostAddSource(simSampleNext, simSample);
+  halHostOnPinWrite(simMotor);
+  serialInit(simUart);
+  if (pty) {
+    const char *name = serialPty();
+
+    if (!name) {
+      perror("sim: pty");
+      return 1;
+    }
+    printf("UART on %s\n", name);
+    fflush(stdout);
+  }
+
+  halHostRun(HAL_HOST_S(seconds));
+  simReport();
+  if (eeprom) simEeprom(eeprom, 1);
+  return 0;
+}
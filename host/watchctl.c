@@ -0,0 +1,196 @@
+#define _DEFAULT_SOURCE     // cfmakeraw, cfsetspeed
+#include <fcntl.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "uart.h"       // The command channel's frame format
+#include "profile.h"    // Regions and the layout of their statistics
+#include "display.h"    // How many characters the watch's tube has
+
+
+// Talks to the watch's command channel, either over a real serial port or over the pty
+// of the simulator (./sim -u prints its name):
+//
+//   ./watchctl /dev/pts/3 time             set the watch to the local time of this computer
+//   ./watchctl /dev/pts/3 time 07:30:00
+//   ./watchctl /dev/pts/3 bright 0-5       the user's VFD brightness
+//   ./watchctl /dev/pts/3 text HELO        displayed for a few seconds
+//   ./watchctl /dev/pts/3 counters
+//   ./watchctl /dev/pts/3 stack            deepest use of the data and the hardware stack since the reset
+//   ./watchctl /dev/pts/3 profile [clear]  times of the profiled regions (a firmware built with the PROFILE)
+//
+// A sleeping watch loses the byte which woke it up, so an unanswered frame is sent again.
+
+#define WATCHCTL_TRIES      3
+#define WATCHCTL_TIMEOUT_MS 200
+
+
+static int watchctlOpen(const char *path) {
+  struct termios mode;
+  int            port = open(path, O_RDWR | O_NOCTTY);
+
+  if (port < 0) return -1;
+  tcgetattr(port, &mode);
+  cfmakeraw(&mode);
+  cfsetspeed(&mode, B38400);
+  mode.c_cflag |= CLOCAL | CREAD;
+  tcsetattr(port, TCSANOW, &mode);
+  tcflush(port, TCIOFLUSH);
+  return port;
+}
+
+
+static uint8_t watchctlFrame(uint8_t command, const uint8_t *payload, uint8_t length, uint8_t *frame) {
+  uint8_t sum = length + command;
+  uint8_t i;
+
+  frame[0] = UART_SYNC;
+  frame[1] = length;
+  frame[2] = command;
+  for (i = 0; i < length; i++) {
+    frame[3 + i] = payload[i];
+    sum         += payload[i];
+  }
+  frame[3 + length] = -sum;
+  return length + UART_OVERHEAD;
+}
+
+
+// Read until a whole frame with a valid check arrives, returns its length or 0 after the timeout
+static uint8_t watchctlReceive(int port, uint8_t *frame) {
+  struct pollfd ready = { port, POLLIN, 0 };
+  uint8_t       length = 0;
+  uint8_t       sum, i;
+
+  while (poll(&ready, 1, WATCHCTL_TIMEOUT_MS) > 0) {
+    if (1 != read(port, &frame[length], 1)) return 0;
+    if (0 == length && UART_SYNC != frame[0]) continue;
+    length++;
+    if (length < 2) continue;
+    if (frame[1] > UART_PAYLOAD_MAX) {
+      length = 0;
+      continue;
+    }
+    if (length < frame[1] + UART_OVERHEAD) continue;
+    for (sum = 0, i = 1; i < length; i++) sum += frame[i];
+    if (!sum) return length;
+    length = 0;
+  }
+  return 0;
+}
+
+
+// Send the frame until it's answered, returns 0 when it never was
+static uint8_t watchctlAsk(int port, uint8_t command, const uint8_t *payload, uint8_t length, uint8_t *reply) {
+  uint8_t frame[UART_PAYLOAD_MAX + UART_OVERHEAD];
+  uint8_t size = watchctlFrame(command, payload, length, frame);
+  uint8_t tries;
+
+  for (tries = 0; tries < WATCHCTL_TRIES; tries++) {
+    if (size != write(port, frame, size)) return 0;
+    if (watchctlReceive(port, reply)) return 1;
+  }
+  return 0;
+}
+
+
+// One line per region, the histogram's buckets are <4us, <16us ... <16ms, the rest
+static int watchctlProfile(int port) {
+  static const char *names[PROFILE_REGIONS] = { PROFILE_NAMES };
+  uint8_t       reply[UART_PAYLOAD_MAX + UART_OVERHEAD];
+  profileRegion stats;
+  uint8_t       region, i;
+
+  printf("%-14s %6s %7s %7s   histogram\n", "region", "count", "min us", "max us");
+  for (region = 0; region < PROFILE_REGIONS; region++) {
+    if (!watchctlAsk(port, UART_PROFILE, &region, 1, reply)) return 3;
+    if (UART_PROFILE != reply[2] || sizeof(stats) != reply[1]) return 2;
+    memcpy(&stats, &reply[3], sizeof(stats));   // Little-endian on both sides
+    printf("%-14s %6u %7u %7u  ", names[region], stats.count,
+           stats.min * PROFILE_TICK_US, stats.max * PROFILE_TICK_US);
+    for (i = 0; i < PROFILE_BUCKETS; i++) printf(" %5u", stats.buckets[i]);
+    printf("\n");
+  }
+  return 0;
+}
+
+
+int main(int argc, char *argv[]) {
+  uint8_t  payload[UART_PAYLOAD_MAX];
+  uint8_t  reply[UART_PAYLOAD_MAX + UART_OVERHEAD];
+  uint8_t  command = 0, length = 0;
+  unsigned h, m, s;
+  int      port, result;
+
+  if (argc >= 3 && !strcmp(argv[2], "time")) {
+    time_t     now   = time(NULL);
+    struct tm *local = localtime(&now);
+
+    h = local->tm_hour;
+    m = local->tm_min;
+    s = local->tm_sec;
+    if (argc >= 4 && 3 != sscanf(argv[3], "%u:%u:%u", &h, &m, &s)) argc = 0;
+    command    = UART_TIME;
+    payload[0] = h;
+    payload[1] = m;
+    payload[2] = s;
+    length     = 3;
+  } else if (argc >= 4 && !strcmp(argv[2], "bright")) {
+    command    = UART_BRIGHTNESS;
+    payload[0] = atoi(argv[3]);
+    length     = 1;
+  } else if (argc >= 4 && !strcmp(argv[2], "text")) {
+    command    = UART_MESSAGE;
+    length     = strlen(argv[3]) > DISPLAY_TEXT_CHARS ? DISPLAY_TEXT_CHARS : strlen(argv[3]);
+    memcpy(payload, argv[3], length);
+  } else if (argc >= 3 && !strcmp(argv[2], "counters")) {
+    command    = UART_COUNTERS;
+  } else if (argc >= 3 && !strcmp(argv[2], "stack")) {
+    command    = UART_STACK;
+  } else if (argc >= 3 && !strcmp(argv[2], "profile")) {
+    command    = UART_PROFILE;        // Only the clear is a single frame, otherwise each region is asked for
+  }
+  if (!command || argc < 3) {
+    fprintf(stderr, "usage: %s port time [HH:MM:SS] | bright level | text ABCD | counters | stack | profile [clear]\n", argv[0]);
+    return 1;
+  }
+
+  port = watchctlOpen(argv[1]);
+  if (port < 0) {
+    perror(argv[1]);
+    return 1;
+  }
+
+  if (UART_PROFILE == command && (argc < 4 || strcmp(argv[3], "clear"))) {
+    result = watchctlProfile(port);
+    if (2 == result) printf("refused\n");
+    if (3 == result) fprintf(stderr, "%s: no answer\n", argv[1]);
+    return result;
+  }
+
+  if (watchctlAsk(port, command, payload, length, reply)) {
+    if (UART_NAK == reply[2]) {
+      printf("refused\n");
+      return 2;
+    }
+    if (UART_COUNTERS == reply[2] && 11 == reply[1]) {
+      printf("wakes %u, time set %u times, awake %us, resets %u, battery %umV\n",
+             reply[3] | reply[4] << 8, reply[5] | reply[6] << 8,
+             reply[7] | reply[8] << 8 | reply[9] << 16 | (unsigned)reply[10] << 24,
+             reply[11], reply[12] | reply[13] << 8);
+    } else if (UART_STACK == reply[2] && 4 == reply[1]) {
+      printf("data stack %u of %u bytes, hardware stack %u of %u bytes\n", reply[3], reply[4], reply[5], reply[6]);
+    } else {
+      printf("ok\n");
+    }
+    return 0;
+  }
+  fprintf(stderr, "%s: no answer\n", argv[1]);
+  return 3;
+}
@@ -0,0 +1,69 @@
+#include <stddef.h>
+#include <stdint.h>
+
+#include "hal_host.h"
+#include "ws2812b.h"
+
+
+#define WS2812B_T1H_MIN_NS   625                     // Between the T0H (0.4us) and T1H (0.8us)
+#define WS2812B_RESET_NS     6000                    // Low for longer than this latches the colours, the newer parts do it after ~6-9us
+#define WS2812B_NS(cycles)   ((uint64_t)(cycles) * 1000000000ULL / HAL_HOST_F_CPU)
+
+uint8_t  ws2812bLeds  = 0;
+uint32_t ws2812bColor[WS2812B_MAX_LEDS];
+uint32_t ws2812bFrames = 0;
+
+static uint32_t ws2812bShift    = 0;                 // Bits received for the current LED
+static uint8_t  ws2812bBits     = 0;
+static uint8_t  ws2812bReceived = 0;                 // LEDs received in the frame which is not latched yet
+static uint8_t  ws2812bActive   = 0;                 // Some bits were received since the last latch
+static uint32_t ws2812bPending[WS2812B_MAX_LEDS];
+static uint64_t ws2812bLastEnd  = 0;
+static void   (*ws2812bOnLatch)(void) = NULL;
+
+
+static uint64_t ws2812bNext(void) {
+  if (!ws2812bActive) return HAL_HOST_NEVER;
+  return ws2812bLastEnd + HAL_HOST_US(WS2812B_RESET_NS / 1000);
+}
+
+
+// The line was low long enough, the LEDs display the received colours
+static void ws2812bLatch(void) {
+  uint32_t channels = 0;
+  uint8_t  i;
+
+  if (ws2812bReceived > WS2812B_MAX_LEDS) ws2812bReceived = WS2812B_MAX_LEDS;
+  for (i = 0; i < ws2812bReceived; i++) {
+    uint32_t grb    = ws2812bPending[i];
+    ws2812bColor[i] = (grb & 0x00FF00) << 8 | (grb & 0xFF0000) >> 8 | (grb & 0x0000FF);
+    channels       += (grb >> 16) + ((grb >> 8) & 0xFF) + (grb & 0xFF);
+  }
+  ws2812bLeds     = ws2812bReceived;
+  ws2812bReceived = 0;
+  ws2812bBits     = 0;
+  ws2812bActive   = 0;
+  ws2812bFrames++;
+  halHostActivity(HAL_HOST_ACTIVITY_NEOPIXEL, channels);
+  if (ws2812bOnLatch) ws2812bOnLatch();
+}
+
+
+void ws2812bPulse(uint64_t startCycle, uint32_t highCycles) {
+  if (ws2812bActive && WS2812B_NS(startCycle - ws2812bLastEnd) > WS2812B_RESET_NS) ws2812bLatch();
+
+  ws2812bShift = (ws2812bShift << 1) | (WS2812B_NS(highCycles) > WS2812B_T1H_MIN_NS);
+  if (24 == ++ws2812bBits) {
+    if (ws2812bReceived < WS2812B_MAX_LEDS) ws2812bPending[ws2812bReceived] = ws2812bShift & 0xFFFFFF;
+    ws2812bReceived++;                                // Extra LEDs would be passed to the next chip in the chain
+    ws2812bBits = 0;
+  }
+  ws2812bActive  = 1;
+  ws2812bLastEnd = startCycle + highCycles;
+}
+
+
+void ws2812bInit(void (*onLatch)(void)) {
+  ws2812bOnLatch = onLatch;
+  halHostAddSource(ws2812bNext, ws2812bLatch);
+}
@@ -0,0 +1,18 @@
+#ifndef SMARTWATCH_HOST_WS2812B_H
+#define SMARTWATCH_HOST_WS2812B_H
+
+#include <stdint.h>
+
+// WS2812B decoder, classifies the high pulses on the PB2 into bits and latches
+// 24-bit GRB colours after the reset (line low for more than 50us)
+
+#define WS2812B_MAX_LEDS 8
+
+extern uint8_t  ws2812bLeds;                         // How many LEDs received a colour in the last frame
+extern uint32_t ws2812bColor[WS2812B_MAX_LEDS];      // Latched colours as 0xRRGGBB
+extern uint32_t ws2812bFrames;                       // How many times the colours were latched
+
+extern void ws2812bPulse(uint64_t startCycle, uint32_t highCycles);
+extern void ws2812bInit(void (*onLatch)(void));      // Optional callback when a new frame is latched
+
+#endif
@@ -0,0 +1,148 @@
+#include <stdint.h>  // `uint8_t` and `uint16_t`
+
+#include "hal.h"     // AVR Mega88 PA (or its simulation)
+#include "pins.h"
+#include "sched.h"
+#include "input.h"
+
+
+volatile uint8_t  inputPresses    = 0;  // Press edges counted by the IRQ
+volatile uint32_t inputPressAt    = 0;  // Scheduler time of the last press edge
+uint32_t          inputHeldFrom   = 0;  // Copy of the inputPressAt for the press being classified
+uint8_t           inputSeen       = 0;  // Presses turned into gestures already
+bit               inputDown       = 0;  // Pressed as far as the gestures are concerned
+bit               inputLong       = 0;  // The LONG of this press was reported already
+bit               inputTracing    = 0;  // A press is waiting for the display to react
+uint8_t           inputClicks     = 0;  // Short presses waiting for the double press window to close
+uint8_t           inputRepeats    = 0;
+uint32_t          inputNextRepeat = 0;
+uint32_t          inputTraceAt    = 0;
+uint16_t          inputLatency    = 0;
+uint16_t          inputLatencyMax = 0;
+
+
+// Called by the pin change IRQ, the IRQ is shared with the square wave so the button might not have changed at all
+void inputSample(uint8_t pins) {
+  static uint8_t last = pinMask(PIN_BUTTON); // Released button is pulled up
+
+  if (!((pins ^ last) & pinMask(PIN_BUTTON))) return;
+  last = pins & pinMask(PIN_BUTTON);
+
+  if (!last) {
+    inputPressAt = schedNow();
+    inputPresses++;
+  }
+
+  halInterruptsDisable();         // Globally disable interrupts
+  pinHigh(PIN_BUTTON);            // Go into internal pull up mode(~30k) to charge the pin up
+  schedPost(SCHED_BUTTON);        // Pressed or released, the super loop will classify it
+  pinLow(PIN_BUTTON);             // Go back to a tri-state mode which is externally pulled up (~1M)
+  halFlagClear(PCIFR, PCIF2);     // Clear pending IRQ caused by the pin charge from possible 0 to 1
+  halInterruptsEnable();          // Globally enable interrupts
+}
+
+
+// While pressed the hold deadline is the next REPEAT or the LONG, whichever comes first
+void inputArm(uint32_t now) {
+  uint32_t at = inputNextRepeat;
+
+  if (!inputLong && (int32_t)(inputHeldFrom + SCHED_MS(INPUT_LONG_MS) - at) < 0) at = inputHeldFrom + SCHED_MS(INPUT_LONG_MS);
+  schedAfter(SCHED_HOLD, ((int32_t)(at - now) > 0) ? at - now : 0);
+}
+
+
+uint8_t inputPress(void) {
+  halInterruptsDisable();         // 32-bit copy, the IRQ could change it in the middle
+  inputHeldFrom   = inputPressAt;
+  halInterruptsEnable();
+
+  inputSeen++;
+  inputDown       = 1;
+  inputLong       = 0;
+  inputRepeats    = 0;
+  inputNextRepeat = inputHeldFrom + SCHED_MS(INPUT_REPEAT_DELAY_MS);
+  inputTraceAt    = inputHeldFrom;
+  inputTracing    = 1;
+  inputArm(schedNow());
+  return INPUT_PRESS;
+}
+
+
+uint8_t inputRelease(uint8_t held) {
+  inputDown = 0;
+  schedCancel(SCHED_HOLD);
+  if (held) {
+    inputClicks = 0;              // The REPEATs or the LONG were the reaction to this press
+    return INPUT_RELEASE;
+  }
+
+  if (++inputClicks >= 2) {
+    inputClicks = 0;
+    return INPUT_DOUBLE;
+  }
+  schedAfter(SCHED_HOLD, SCHED_MS(INPUT_DOUBLE_MS));
+  return INPUT_RELEASE;
+}
+
+
+uint8_t inputHold(void) {
+  uint32_t now = schedNow();
+
+  if (!inputDown) {
+    // The double press window closed with a single click
+    inputClicks = 0;
+    return INPUT_SHORT;
+  }
+
+  if (!inputLong && (int32_t)(now - inputHeldFrom - SCHED_MS(INPUT_LONG_MS)) >= 0) {
+    // The LONG usually switches to something else to adjust, the REPEATs start over for it
+    inputLong       = 1;
+    inputRepeats    = 0;
+    inputNextRepeat = now + SCHED_MS(INPUT_REPEAT_DELAY_MS);
+    inputArm(now);
+    return INPUT_LONG;
+  }
+
+  if (inputRepeats < 255) inputRepeats++;
+  inputNextRepeat += (inputRepeats < INPUT_ACCELERATE) ? SCHED_MS(INPUT_REPEAT_MS) : SCHED_MS(INPUT_REPEAT_FAST_MS);
+  inputArm(now);
+  return INPUT_REPEAT;
+}
+
+
+// The edges are handled one at a time, when the IRQ was faster than the super loop
+// (a quick click while it was busy) the event is posted again for the rest of them
+uint8_t inputGesture(void) {
+  uint8_t gesture;
+
+  if (schedTake(SCHED_BUTTON)) {
+    if (!inputDown && inputSeen != inputPresses) {
+      gesture = inputPress();
+      if (pinRead(PIN_BUTTON) || inputSeen != inputPresses) schedPost(SCHED_BUTTON); // Released already
+      return gesture;
+    }
+    if (inputDown && (pinRead(PIN_BUTTON) || inputSeen != inputPresses)) {
+      if (inputSeen != inputPresses) schedPost(SCHED_BUTTON);
+      return inputRelease(inputLong || inputRepeats);
+    }
+    return INPUT_NONE;           // Bounce, the level is the same as before
+  }
+
+  if (schedTake(SCHED_HOLD)) return inputHold();
+  return INPUT_NONE;
+}
+
+
+uint8_t inputStep(void) {
+  if (inputRepeats < INPUT_ACCELERATE)     return 1;
+  if (inputRepeats < INPUT_ACCELERATE * 2) return 5;
+  return 10;
+}
+
+
+void inputDisplayed(void) {
+  if (!inputTracing) return;
+  inputTracing = 0;
+  inputLatency = (uint16_t)(schedNow() - inputTraceAt);
+  if (inputLatency > inputLatencyMax) inputLatencyMax = inputLatency;
+}
@@ -0,0 +1,45 @@
+#ifndef SMARTWATCH_INPUT_H
+#define SMARTWATCH_INPUT_H
+
+#include <stdint.h> // `uint8_t` and `uint16_t`
+
+// Gestures of the WAKE-UP button. The pin change IRQ only timestamps the edges, the super
+// loop turns them into gestures with the SCHED_BUTTON and SCHED_HOLD events. The hold
+// deadline is shared, while pressed it times the repeats, after a release the double press.
+//
+//   __     _________            __     ___     ___________
+//     |___|          SHORT        |___|   |___|           DOUBLE
+//         <-250ms->
+//   __                                                   _________
+//     |_________________________________________________|
+//        500ms  +400ms  +400ms     2s   +500ms
+//        REPEAT REPEAT  REPEAT ..  LONG REPEAT .. REPEAT     (nothing on the release)
+
+#define INPUT_DOUBLE_MS        250  // The second press has to come this soon after the first release
+#define INPUT_REPEAT_DELAY_MS  500  // Held this long -> the first REPEAT
+#define INPUT_REPEAT_MS        400  // Then the REPEATs come this often
+#define INPUT_REPEAT_FAST_MS   200  // And even more often after the INPUT_ACCELERATE repeats
+#define INPUT_LONG_MS          2000 // Held this long -> LONG (once per press, the REPEATs start over after it)
+#define INPUT_ACCELERATE       8    // Every 8 repeats the step gets bigger (1, 5, 10)
+
+// Gestures returned by the inputGesture()
+#define INPUT_NONE             0
+#define INPUT_PRESS            1    // Pressed right now, before it's known what it will be
+#define INPUT_SHORT            2    // Pressed and released once
+#define INPUT_DOUBLE           3    // Pressed and released twice in a quick succession
+#define INPUT_LONG             4    // Still held after the INPUT_LONG_MS
+#define INPUT_REPEAT           5    // Still held, another step of the auto-repeat
+#define INPUT_RELEASE          6    // Released, a SHORT or DOUBLE might still follow
+
+
+extern uint8_t  inputRepeats;                 // REPEATs of the current press (since the LONG)
+extern uint16_t inputLatency;                 // Last press to display update in scheduler ticks (128us)
+extern uint16_t inputLatencyMax;              // The worst one since the reset
+
+
+extern void    inputSample(uint8_t pins);    // Called by the pin change IRQ with the PIND
+extern uint8_t inputGesture(void);           // Called from the super loop, one gesture at a time
+extern uint8_t inputStep(void);              // How much the current REPEAT should change a value (1, 5 or 10)
+extern void    inputDisplayed(void);         // The display shows the reaction to the last press, stop its latency timer
+
+#endif
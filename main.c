@@ -8,173 +8,418 @@ Memory model            : Small
 Data Stack size         : 128 bytes
 *******************************************************/
 
-#include <mega88a.h>    // AVR Mega88 PA
-#include <ds3231_twi.h> // DS3231 Real Time Clock functions for TWI(I2C)
-#include <sleep.h>      // Power managment
 #include <stdint.h>     // `uint8_t` instead `unsigned char` and `uint16_t` instead `unsigned int`
 
+#include "hal.h"        // AVR Mega88 PA and power managment (or their simulation)
+#include "pins.h"
 #include "main.h" 
 #include "reset.h"
 #include "vfd.h"
-#include "neopixel.h"
+#include "animation.h"
+#include "clock.h"
+#include "sched.h"
+#include "input.h"
+#include "store.h"
+#include "stack.h"
+#include "battery.h"
+#include "power.h"
+#include "alarm.h"
+#include "uart.h"
+#include "profile.h"
 
 
-volatile uint8_t buttonPressed  = 0; // Counter how long the WAKE-UP button is pressed (20Hz counter)
-volatile bit     timeStale      = 0; // Flag to force 1Hz update from RTC to get correct time
-volatile uint8_t systick        = 0; // 20Hz systick counter
+#if PROFILE && 6 + 2 * PROFILE_BUCKETS > UART_PAYLOAD_MAX
+#error "A region's statistics have to fit one UART frame"
+#endif
 
-uint8_t rtcHour                 = 8; // On power up start with 8:00 time
+#if VFD_TEXT_CHARS > UART_PAYLOAD_MAX
+#error "A message for the whole tube has to fit one UART frame"
+#endif
+
+
+uint8_t rtcHour                 = 255; // Not known until the RTC is read, the first read applies the brightness for its hour
 uint8_t rtcMinute               = 0;
+uint8_t mainState               = 0; // 0 display clock, 1 set hours, 2 set minutes, 3 set alarm hours, 4 set alarm minutes
+uint32_t awakeAtReset           = 0; // The storeState.awakeSeconds before this reset
+bit messageShown                = 0; // A message from the UART is displayed instead of the time
 
 
 
-// Timer1 output compare A interrupt service routine (a 20Hz systick)
-interrupt [TIM1_COMPA] void timer1_compa_isr(void) {
-  systick = (systick + 1) % SYSTICK_MAX;     // 20Hz tick counter                                    
-  neopixelUpdate = 1;                        // Flag set true to update the Neopixel at systick frequency
-  if (0 == systick) timeStale = 1;           // 1Hz flag to force the RTC update    
-  stayAwake = (stayAwake) ? stayAwake-1 : 0; // Countdown to 0               
-                
-  // Count how long the WAKE-UP button is pressed
-  if (PIND & (1<<PORTD2)) {
-    // Is in pull-up state means the button is not pressed
-    buttonPressed = 0;    
-  } else {
-                                                 
-    // Button is pressed right now
-    if (buttonPressed < 255) {
-      // At certain point we do not need to count any further, just do not overflow
-      buttonPressed++;
-    } 
-  }
+// Pin change 16-23 interrupt service routine
+// filtered to PCINT18/PD2 pin -> level changed on the WAKE-UP button
+// and to PCINT19/PD3 pin -> the DS3231's 1Hz square wave (only while awake)
+// and to PCINT16/PD0 pin -> a byte on the UART's RXD (only while sleeping, the wake-up is all it does)
+HAL_ISR(PC_INT2) void pin_change_isr2(void) {
+  uint8_t pins = pinInputs(PIN_BUTTON); // Sample both pins once, the IRQ is shared
 
+  profileBegin(PROFILE_ISR_INPUT);
+  clockSqwSample((pins & pinMask(PIN_RTC_SQW)) ? 1 : 0);
+  inputSample(pins);                    // The square wave edges alone do not keep the watch awake
+  profileEnd(PROFILE_ISR_INPUT);
 }
 
 
-// Pin change 16-23 interrupt service routine
-// filtered to PCINT18/PD2 pin -> level changed on the WAKE-UP button
-interrupt [PC_INT2] void pin_change_isr2(void) {
-  #asm("cli")                     // Globally disable interrupts
-  PORTD         |= (1<<PORTD2);   // Go into internal pull up mode(~30k) to charge the pin up
-  buttonPressed  = 0;             // Button state changed, start counting from scratch
-  PORTD         &= ~(1<<PORTD2);  // Go back to a tri-state mode which is externally pulled up (~1M) 
-  stayAwake      = SLEEP_TIMEOUT; // Pressing or lifting the button will keep us awake
-  PCIFR         |= (1<<PCIF2);    // Clear pending IRQ caused by the pin charge from possible 0 to 1
-  #asm("sei")                     // Globally enable interrupts    
+// The Neopixel's colour while showing the clock, blinking when the battery is nearly empty
+uint8_t clockAnimation(void) {
+  return (BATTERY_CRITICAL == batteryLevel) ? ANIMATION_LOW_BATTERY : ANIMATION_CLOCK;
 }
 
 
-// Something changed, maybe a pressed button or a clock state changed. Counters need to start from scratch.
+// Something changed, maybe a pressed button or a clock state changed. Timeouts need to start from scratch.
 void actionHappenedResetCounters(void) {
-  buttonPressed = 0; 
-  stayAwake     = SLEEP_TIMEOUT;
+  uint32_t timeout = batteryTimeout(storeState.timeout * 1000UL); // Shorter with a low battery
+
+  schedAfter(SCHED_SLEEP,    SCHED_MS(timeout));
+  schedAfter(SCHED_FADE_OUT, SCHED_MS(timeout - ANIMATION_POWER_DOWN_TICKS * ANIMATION_FRAME_MS));
+  if (mainState > 0) schedAfter(SCHED_INACTIVE, SCHED_MS(SET_TIME_IDLE_MS));
+
+  // The fade-out already started, but something kept us awake
+  if (ANIMATION_POWER_DOWN == animationPlaying()) animationPlay(clockAnimation());
 }
 
 
-// Handle all 3 states the clock can be in
+// A new battery measurement (once per wake-up), the battery module already applied its limits,
+// in the clock mode switch between the steady and the blinking red when the level requires it
+void batteryChecked() {
+  uint8_t playing;
+
+  if (!batteryHandler()) return;
+  actionHappenedResetCounters(); // The timeout armed at the wake-up used the previous level
+
+  playing = animationPlaying();
+  if (ANIMATION_POWER_UP != playing && ANIMATION_CLOCK != playing && ANIMATION_LOW_BATTERY != playing) return;
+  if ((BATTERY_CRITICAL == batteryLevel) != (ANIMATION_LOW_BATTERY == playing)) animationPlay(clockAnimation());
+}
+
+
+// 'AL' followed by the hours or the minutes of the alarm being set, 'OFF' for a disabled alarm
+void displayAlarm(uint8_t value) {
+  char text[5] = "AL  ";
+
+  if (ALARM_OFF == value) {
+    displayText("OFF");
+    return;
+  }
+  text[2] = '0' + value / 10;
+  text[3] = '0' + value % 10;
+  displayText(text);
+}
+
+
+// Handle all 5 states the clock can be in, only when the button, the RTC or a timeout posted an event
 void setTimeStateMachine() {
   // state 0 normal operation - display clock
   // state 1 set hours
   // state 2 set minutes
+  // state 3 set alarm hours (or off)
+  // state 4 set alarm minutes
   
-  static uint8_t state  = 0;           
+  uint8_t redraw = schedTake(SCHED_SECOND | SCHED_RTC); // Square wave edge or the RTC read finished
+  uint8_t gesture;
+
+  if (schedTake(SCHED_MESSAGE)) {
+    // The message was displayed long enough, back to the time
+    messageShown = 0;
+    redraw       = 1;
+  }
 
-  switch (state) {
+  gesture = inputGesture();
+  if (gesture) {
+    // Pressing or lifting the button will keep us awake
+    redraw = 1;
+    if (alarmRinging && (INPUT_SHORT == gesture || INPUT_LONG == gesture)) {
+      // A click snoozes the alarm, holding the button dismisses it
+      if (INPUT_SHORT == gesture) alarmSnooze();
+      else                        alarmDismiss();
+      animationPlay(clockAnimation());
+    } else if (INPUT_LONG == gesture && 0 == mainState) {
+      // Pressed button for too long -> go into the 'Set time' states 
+      mainState = 1;
+      animationPlay(ANIMATION_SET_HOURS);
+    } else if (INPUT_DOUBLE == gesture && mainState > 0) {
+      schedPost(SCHED_INACTIVE); // Done with this one, go to the next state right away
+    } else if ((INPUT_SHORT == gesture || INPUT_REPEAT == gesture) && mainState > 0) {
+      // A click is one step, holding the button repeats and the minutes speed up (1, 5, 10)
+      uint8_t step = (INPUT_REPEAT == gesture) ? inputStep() : 1;
+
+      switch (mainState) {
+        case 1:  rtcHour     = (rtcHour + 1) % 24;                break;
+        case 2:  rtcMinute   = (rtcMinute + step) % 60;           break;
+        case 3:  alarmHour   = (alarmHour + 1) % (ALARM_OFF + 1); break;  // 0-23 and off
+        default: alarmMinute = (alarmMinute + step) % 60;         break;
+      }
+    }
+    // A click while just showing the clock does nothing, it was kept awake by its press and release already
+    if (mainState > 0 || INPUT_PRESS == gesture || INPUT_RELEASE == gesture) actionHappenedResetCounters();
+  }
+
+  if (schedTake(SCHED_INACTIVE)) {
+    // If currently in any setting mode, then after a few seconds of inactivity go to the next state automatically
+    redraw = 1;
+    mainState++;                                                                                              
+    if (3 == mainState) {
+      // Done with setting the time, save the new time to the RTC chip and continue with the alarm
+      clockSet(rtcHour, rtcMinute, 0);
+      storeState.setTimes++;
+    }
+    if (4 == mainState && ALARM_OFF == alarmHour) mainState++;  // A disabled alarm has no minutes to set
+    if (mainState > 4) {
+      // Reached the end of state machine, save the alarm to the RTC chip and go to normal operation 
+      alarmSet();
+      mainState = 0;  
+      animationPlay(clockAnimation());    
+    } else {
+      animationPlay((mainState & 1) ? ANIMATION_SET_HOURS : ANIMATION_SET_MINUTES);
+    }
+    actionHappenedResetCounters();      
+  }
+
+  if (!redraw) return;
+
+  // The field being set blinks with the square wave, a step shows it right away
+  vfdBlinkOff = (gesture || clockColon) ? 0 : 1;
+
+  switch (mainState) {
     
     case 1:  // Set hours
-      systick = 0; // Do not display the ':' dots when setting the hours  
-      if (buttonPressed > PRESS_SHORT) {
-        rtcHour = (rtcHour + 1) % 24;
-        actionHappenedResetCounters();
-      }                               
-      
-      // Display only hours         
+      // Display the whole time with the steady ':' dots, the hours blink
+      vfdColon  = 1;
       vfdHour   = rtcHour;
-      vfdMinute = 255;            
+      vfdMinute = rtcMinute;
+      vfdBlink  = VFD_BLINK_HOURS;
     break;              
       
     case 2:  // Set minutes
-      systick = 0; // Do not display the ':' dots when setting the hours  
-      if (buttonPressed > PRESS_SHORT) {
-        rtcMinute = (rtcMinute + 1) % 60;
-        actionHappenedResetCounters(); 
-      }
-      
-      // Display only hours         
-      vfdHour   = 255;
-      vfdMinute = rtcMinute;     
+      vfdColon  = 1;
+      vfdHour   = rtcHour;
+      vfdMinute = rtcMinute;
+      vfdBlink  = VFD_BLINK_MINUTES;
+    break;
+
+    case 3:  // Set alarm hours, rendered below, the value blinks ('OFF' as a whole)
+    case 4:  // Set alarm minutes
+      vfdBlink  = (ALARM_OFF == alarmHour) ? VFD_BLINK_HOURS | VFD_BLINK_MINUTES : VFD_BLINK_MINUTES;
     break;
       
     default: // state 0 -> normal clock operation        
-      if (buttonPressed > PRESS_TO_SET_TIME) {
-        // Pressed button for too long -> go into the 'Set time' states 
-        state = 1;
-        neopixelSetColor(NEOPIXEL_SET_HOURS_COLOR);
-        actionHappenedResetCounters(); 
-      } else {                                    
-      
-        // Nothing pressed, just display the clock
-        if (timeStale) {  
-          // Do 1Hz RTC update of the exact time
-          uint8_t second; // Seconds are not displayed and not used anywhere 
-          rtc_get_time(&rtcHour, &rtcMinute, &second);               
-                    
-          timeStale = 0;             
-        }
+      vfdBlink  = 0;
+      // Just display the clock, the seconds are counted 
+      // from the RTC's square wave so no TWI transaction is needed here
+      if (!clockUpdate()) {
+        // Just woken up and the RTC is still being read, keep the digits blank meanwhile
+        vfdHour   = 255;
+        vfdMinute = 255;
+        break;
       }
+      if (rtcHour != clockHour) vfdBrightnessForHour(clockHour); // Night mode follows the time
+      rtcHour   = clockHour;
+      rtcMinute = clockMinute;
       
-      // Let VFD display exactly the same time as we get from RTC
+      // Let VFD display exactly the same time as the RTC has, with the ':' locked to its square wave
       vfdHour   = rtcHour;
       vfdMinute = rtcMinute;          
+      vfdColon  = clockColon;
+
+      // Ring at the alarm's minute, the minutes come from the square wave so no RTC access is needed here either
+      alarmCheck(clockHour, clockMinute);
+      if (alarmRinging && ANIMATION_ALARM != animationPlaying()) animationPlay(ANIMATION_ALARM);
     break; // Not needed here, but just for consistency sake      
   }
-    
-  if ( (state > 0) && (stayAwake < (SLEEP_TIMEOUT - PRESS_TO_SET_TIME)) ) { 
-    // If currently in any setting mode, then after a few seconds of inactivity go to the next state automatically
-    state++;                                                                                              
-    neopixelSetColor(NEOPIXEL_SET_MINUTES_COLOR);
-    actionHappenedResetCounters();      
+
+  // Render the time (or the alarm) into the VFD's frame buffer, refresh is done by IRQs,
+  // a message keeps its frame, but the seconds were counted above
+  if (!messageShown) {
+    if (mainState < 3) displayTime();
+    else           displayAlarm((3 == mainState) ? alarmHour : alarmMinute);
   }
-    
-  if (state > 2) {
-    // Reached the end of state machine, done with setting the time, 
-    // save the new time to the RTC chip and go to normal operation 
-    rtc_set_time(rtcHour, rtcMinute, 0);
-    state = 0;  
-    neopixelSetColor(NEOPIXEL_CLOCK_COLOR);    
-    actionHappenedResetCounters();       
+  inputDisplayed(); // The reaction to a press is in the frame buffer now
+}
+
+
+// Commands received over the UART, parsed in place in the RX ring. Each one is answered (or refused with the
+// UART_NAK) and keeps the watch awake. The time and the message are refused while the button is setting the time.
+void uartCommands() {
+  uint8_t command, length, i;
+  uint8_t ok;
+  uint8_t reply[11];
+  uint8_t *payload;
+  uint8_t replyLength;
+  char    text[VFD_TEXT_CHARS + 1];
+
+  if (!schedTake(SCHED_UART)) return;
+
+  while ((command = uartFrame())) {
+    length      = uartFrameLength();
+    ok          = 0;
+    payload     = reply;
+    replyLength = 0;
+
+    switch (command) {
+      case UART_TIME:
+        // Together with the seconds, so the host can sync the time in one frame
+        if (3 != length || mainState > 0) break;
+        if (uartFramePayload(0) > 23 || uartFramePayload(1) > 59 || uartFramePayload(2) > 59) break;
+        clockSet(uartFramePayload(0), uartFramePayload(1), uartFramePayload(2));
+        storeState.setTimes++;
+        schedPost(SCHED_SECOND);        // Redraw right away
+        ok = 1;
+      break;
+
+      case UART_BRIGHTNESS:
+        if (1 != length || uartFramePayload(0) >= VFD_BRIGHTNESS_LEVELS) break;
+        vfdBrightness         = uartFramePayload(0);
+        storeState.brightness = vfdBrightness;
+        vfdBrightnessForHour(clockHour);
+        ok = 1;
+      break;
+
+      case UART_MESSAGE:
+        if (0 == length || length > VFD_TEXT_CHARS || mainState > 0) break;
+        for (i = 0; i <= VFD_TEXT_CHARS; i++) text[i] = (i < length) ? uartFramePayload(i) : 0;
+        displayText(text);
+        messageShown = 1;
+        schedAfter(SCHED_MESSAGE, SCHED_MS(MESSAGE_MS));
+        ok = 1;
+      break;
+
+      case UART_COUNTERS:
+        if (0 != length) break;
+        reply[0]  = storeState.wakes;
+        reply[1]  = storeState.wakes >> 8;
+        reply[2]  = storeState.setTimes;
+        reply[3]  = storeState.setTimes >> 8;
+        storeState.awakeSeconds = awakeAtReset + schedNow() / SCHED_MS(1000);
+        for (i = 0; i < 4; i++) reply[4 + i] = storeState.awakeSeconds >> (8 * i);
+        reply[8]  = storeState.resets;
+        reply[9]  = batteryMillivolts;
+        reply[10] = batteryMillivolts >> 8;
+        replyLength = 11;
+        ok = 1;
+      break;
+
+      case UART_STACK:
+        if (0 != length) break;
+        reply[0] = stackDataUsed();
+        reply[1] = HAL_DATA_STACK_SIZE;
+        reply[2] = stackHwUsed();
+        reply[3] = HAL_HW_STACK_SIZE;
+        replyLength = 4;
+        ok = 1;
+      break;
+
+#if PROFILE
+      case UART_PROFILE:
+        // The statistics go out straight from the RAM, only the profiling builds know this command
+        if (0 == length) {
+          profileClear();
+        } else {
+          if (1 != length || uartFramePayload(0) >= PROFILE_REGIONS) break;
+          payload     = (uint8_t *)&profileRegions[uartFramePayload(0)];
+          replyLength = sizeof(profileRegion);
+        }
+        ok = 1;
+      break;
+#endif
+    }
+
+    uartFrameDone();
+    if (ok) {
+      uartReply(command, payload, replyLength);
+    } else {
+      reply[0] = command;
+      uartReply(UART_NAK, reply, 1);
+    }
+    actionHappenedResetCounters();
+  }
+}
+
+
+// The vibration pattern keeps the watch awake until the button (or giving up after a minute) stops it
+void alarmStepped() {
+  switch (alarmHandler()) {
+    case ALARM_RINGING: actionHappenedResetCounters();    break;
+    case ALARM_GAVE_UP: animationPlay(clockAnimation()); break;
   }
 }
 
 
 void lowPowerAndWakingUp() {
-  uint8_t second; // Seconds are not displayed and not used anywhere 
-  
-  if (0 == stayAwake) {           
+  uint8_t alarm;
+
+  if (schedTake(SCHED_FADE_OUT)) {
+    // Fade out during the last moments before going to sleep
+    animationPlay(ANIMATION_POWER_DOWN);
+  }
+
+  if (schedTake(SCHED_SLEEP)) {           
     // Reached sleep timeout, going to power down state
-    neopixelSetColor(NEOPIXEL_BLACK_COLOR);
+    schedCancel(SCHED_FADE_OUT);
+    animationOff();
     vfdOff();
-    powerdown(); // External IRQ caused by the WAKE-UP button can resume the CPU
+    clockSleep(alarmSleep()); // The square wave would wake us up every second, only the armed alarms can
+    uartSleep();              // A host talking to us wakes us up
+    messageShown = 0;
+    schedCancel(SCHED_MESSAGE);
+
+    // The counters and the last known time go to the EEPROM once per sleep cycle. The Timer1 runs only
+    // while awake, so the scheduler's time is the time spent awake since the reset.
+    storeState.hour         = clockHour;
+    storeState.minute       = clockMinute;
+    storeState.awakeSeconds = awakeAtReset + schedNow() / SCHED_MS(1000);
+    storeFlush();
+    storeWait();  // A write in progress would keep the oscillator running in the power-down
+
+    powerDown();  // External IRQ caused by the WAKE-UP button can resume the CPU, the Timer1 is stopped meanwhile
+
+    // The VFD's power sequence is the longest part of a glance (1.5ms until the refresh starts), so it
+    // starts first, everything else runs while the filament heats. The RTC read finishes in ~0.6ms,
+    // the time is in the frame buffer before the first slot and the digits appear at once (no fade-in).
+    vfdOn();
+    storeState.wakes++;
+    alarm = alarmWoke();  // Before the clockWake clears the RTC's alarm flags
+    uartWake();
                     
-    // After waking up, get the current time as a lot of time could have passed
-    rtc_get_time(&rtcHour, &rtcMinute, &second);            
-    neopixelFadeCountDown = NEOPIXEL_START_FADE; // Start Neopixel's fade from black to red 
-    vfdOn();                            
+    // After waking up, get the current time as a lot of time could have passed, the read
+    // finishes in the background and the brightness follows once the hour is known
+    clockWake();
+    animationPlay(ANIMATION_POWER_UP); // Start Neopixel's fade from black to red 
+    batteryMeasure();                   // Once per wake-up, with the filament loading the battery
+    actionHappenedResetCounters();
+    if (alarm) {
+      // Ring right away, without waiting for the time to be read
+      alarmRing();
+      animationPlay(ANIMATION_ALARM);
+    }
   }
 }
 
 
 void main(void) {            
+  stackPaint();                                // Before anything else runs, to catch the deepest use of the stacks
   systemPeripheralsSetup();                    // Set all peripherals into a known state      
-  rtc_set_time(rtcHour, rtcMinute, 0);         // Set RTC clock to a known time  
-  neopixelFadeCountDown = NEOPIXEL_START_FADE; // Start Neopixel's fade from black to red
+  profileInit();                               // Only in the profiling builds
+  storeInit();                                 // Settings and counters from the newest EEPROM record
+  awakeAtReset  = storeState.awakeSeconds;
+  vfdBrightness = storeState.brightness;
+  clockStart(storeState.hour, storeState.minute); // Read the RTC, the stored time is used only if the RTC lost it
+  batteryMeasure();                            // The policy follows as soon as the ADC is done
+  animationPlay(ANIMATION_POWER_UP);           // Start Neopixel's fade from black to red
+  actionHappenedResetCounters();               // Start the sleep timeout
+  schedPost(SCHED_SECOND);                     // Display the time right away, not at the first square wave edge
 
   while (1) {                                  // The super loop -> whole life of this watch                   
                            
-    setTimeStateMachine();                     // Handles 'Set Time' functionality                               
-    displayTime();                             // The VFD needs constant refresh 
-    neopixelFadeHandler();                     // Updates the Neopixel color when the fade is enabled       
+    profileBegin(PROFILE_LOOP);
+    schedRun();                                // Post the events of the deadlines which passed
+    setTimeStateMachine();                     // Handles 'Set Time' functionality and renders the time
+    batteryChecked();                          // Applies the power policy of a new battery measurement
+    uartCommands();                            // Answers the commands received over the UART
+    vfdHandler();                              // Steps the VFD power sequence (filament, DC2DC, refresh, preheat)
+    alarmStepped();                            // Vibrates the alarm's pattern
+    animationHandler();                        // Plays the Neopixel animation, sends only the changed colors       
     lowPowerAndWakingUp();                     // Goes into low-power mode after a timeout 
+    profileEnd(PROFILE_LOOP);
+    schedSleep();                              // Sleep until the next IRQ or deadline (VFD refresh, button, square wave, TWI)
   } 
   
 }
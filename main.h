@@ -3,11 +3,8 @@
 
 #include <stdint.h> // `uint8_t` and `uint16_t` 
 
-#define SYSTICK_MAX       20 // Systick will count only from 0 to 19
-#define PRESS_TO_SET_TIME 40 // 40 * 0.05s  = 2.0s press to trigger the 'set time'
-#define PRESS_SHORT       10 // 10 * 0.05s  = 0.5s for short press
-
-
-extern volatile uint8_t systick; // 20Hz systick counter
+#define SLEEP_TIMEOUT_MS     12000 // 12s without pressing anything before turning off the VFD
+#define SET_TIME_IDLE_MS     2000  // 2.0s of inactivity moves the 'set time' to the next state
+#define MESSAGE_MS           4000  // How long a message pushed over the UART is displayed instead of the time
 
 #endif
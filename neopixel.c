@@ -1,111 +1,186 @@
 #include <stdint.h>
 
+#include "hal.h"
+#include "pins.h"
 #include "neopixel.h"
 #include "vfd.h"
+#include "profile.h"
 
 
-uint8_t      neopixelFadeCountDown = 0;  // Count down for how the Neopixel increase in brightness should be done  
-volatile bit neopixelUpdate        = 0;  // A 'update flag' set true at the systick frequency
-    
-
-// Swap the order of the lower 4 bits between each other (the higher 4-bits will be discarded)
-uint8_t reverse4bits(uint8_t value) {
-  return ((value & (1<<0)) << 3) |  // Move bit 0 to bit 3
-         ((value & (1<<1)) << 1) |  // Move bit 1 to bit 2          
-         ((value & (1<<2)) >> 1) |  // Move bit 2 to bit 1
-         ((value & (1<<3)) >> 3);   // Move bit 3 to bit 0
-}                        
-
-
-// Fading only the red color only
-void neopixelFadeHandler(void) {
-  if (neopixelUpdate) {
-    // Consider doing the Neopixel update only once per systick
-    
-    if (neopixelFadeCountDown) {
-      // At the first 16 ticks of the systick timer the color will fade from black to red
-      // only if the neopixelFadeUp is setup. This way the fade will happen only on
-      // powerup but not any other button presses which reset the stayAwake counter     
-      
-      neopixelFadeCountDown--;
-      if (neopixelFadeCountDown) {
-        neopixelSetColor(reverse4bits((NEOPIXEL_START_FADE - neopixelFadeCountDown)/NEOPIXEL_FADE_SPEED) << 4);
-      } else {
-        neopixelSetColor(NEOPIXEL_CLOCK_COLOR); // Final color is reached
-      }      
-    }
-    
-    if ((NEOPIXEL_START_FADE * NEOPIXEL_FADE_SPEED) > stayAwake) {
-      // At the last 16 ticks of the systick timer the color will fade from red to black
-      neopixelSetColor(reverse4bits((stayAwake)/NEOPIXEL_FADE_SPEED) << 4);
+// WS2812B bit timing derived from the CPU clock at the compile time. The bit loop below
+// has fixed instruction costs and the padding NOPs (W1, W2, W3) stretch it to the datasheet.
+// The pin changes at the end of the SBI/CBI, so a '0' is high for W1+3 cycles (SBRS, CBI),
+// a '1' for W1+W2+5 (SBRS skipping, LSL, CBI). The whole bit takes W1+W2+W3+10 for a '1' and
+// one more for a '0' (the SBRS doesn't skip, but the CBI runs), the W3 makes the '1' the
+// period and the '0' is 125ns longer. The last bit's BRNE falls through, it's 1 cycle shorter.
+// The low part is not critical, it can be longer as long as it stays below the reset, the
+// newer WS2812B latch after only ~6-9us of low (the 50us of the old datasheet is the longest),
+// so the whole frame is sent with the IRQs disabled.
+#define NEOPIXEL_CYCLES(ns)   ((HAL_F_CPU / 1000000UL * (ns) + 999) / 1000)  // Rounded up
+#define NEOPIXEL_T0H          NEOPIXEL_CYCLES(350)
+#define NEOPIXEL_T1H          NEOPIXEL_CYCLES(700)
+#define NEOPIXEL_PERIOD       NEOPIXEL_CYCLES(1250)
+
+// Cycles of the instructions of the bit loop, from the AVR instruction set manual
+#define NEOPIXEL_SBI          2
+#define NEOPIXEL_CBI          2
+#define NEOPIXEL_SBRS         1   // The MSB is 0, nothing skipped
+#define NEOPIXEL_SBRS_SKIP    2   // The MSB is 1, the 1-word CBI skipped
+#define NEOPIXEL_LSL          1
+#define NEOPIXEL_DEC          1
+#define NEOPIXEL_BRNE_TAKEN   2   // To the next bit
+#define NEOPIXEL_BRNE         1   // After the last bit
+
+#define NEOPIXEL_HIGH_0_FIXED (NEOPIXEL_SBRS + NEOPIXEL_CBI)
+#define NEOPIXEL_HIGH_1_FIXED (NEOPIXEL_SBRS_SKIP + NEOPIXEL_LSL + NEOPIXEL_CBI)
+#define NEOPIXEL_BIT_1_FIXED  (NEOPIXEL_SBI + NEOPIXEL_SBRS_SKIP + NEOPIXEL_LSL + NEOPIXEL_CBI + NEOPIXEL_DEC + NEOPIXEL_BRNE_TAKEN)
+#define NEOPIXEL_BIT_0_FIXED  (NEOPIXEL_SBI + NEOPIXEL_SBRS + NEOPIXEL_CBI + NEOPIXEL_LSL + NEOPIXEL_CBI + NEOPIXEL_DEC + NEOPIXEL_BRNE_TAKEN)
+
+#define NEOPIXEL_W1           ((NEOPIXEL_T0H > NEOPIXEL_HIGH_0_FIXED) ? (NEOPIXEL_T0H - NEOPIXEL_HIGH_0_FIXED) : 0)
+#define NEOPIXEL_W2           ((NEOPIXEL_T1H > NEOPIXEL_W1 + NEOPIXEL_HIGH_1_FIXED) ? (NEOPIXEL_T1H - NEOPIXEL_W1 - NEOPIXEL_HIGH_1_FIXED) : 0)
+#define NEOPIXEL_W3           ((NEOPIXEL_PERIOD > NEOPIXEL_W1 + NEOPIXEL_W2 + NEOPIXEL_BIT_1_FIXED) ? \
+                               (NEOPIXEL_PERIOD - NEOPIXEL_W1 - NEOPIXEL_W2 - NEOPIXEL_BIT_1_FIXED) : 0)
+#define NEOPIXEL_BIT_0        (NEOPIXEL_W1 + NEOPIXEL_W2 + NEOPIXEL_W3 + NEOPIXEL_BIT_0_FIXED)   // The longer bit
+#define NEOPIXEL_CALL_CYCLES  24  // The call of the neopixelSendByte and the loop around it, once per byte
+
+// The assembly below drives the PB2 directly
+#if !pinIsOn(PIN_NEOPIXEL, B) || pinMask(PIN_NEOPIXEL) != (1 << 2)
+#error "The Neopixel assembly has the PB2 hardcoded"
+#endif
+
+#if (NEOPIXEL_W1 > 15) || (NEOPIXEL_W2 > 15) || (NEOPIXEL_W3 > 15)
+#error "The CPU clock is too fast for the Neopixel padding, add more NOPs"
+#endif
+
+// A frame delays the IRQs by 24 bits per LED (~36us at 8MHz, the loop is longer than the 1.25us
+// period there). The VFD's refresh is frozen in a blanked part of a slot meanwhile (vfdPause),
+// so no on-time is stretched, the other IRQs are just late. The UART's receiver buffers two bytes
+// (520us) and the profiler's Timer2 overflows every 256us, the frame has to stay below both.
+#define NEOPIXEL_IRQ_OFF_US   (NEOPIXEL_COUNT * 3UL * (8 * NEOPIXEL_BIT_0 + NEOPIXEL_CALL_CYCLES) * 1000000UL / HAL_F_CPU)
+
+#if NEOPIXEL_IRQ_OFF_US > 250
+#error "The chain is too long to be sent with the IRQs disabled"
+#endif
+
+
+uint8_t neopixelPixels[NEOPIXEL_COUNT * 3];
+
+
+// Send one byte to the chain, MSB first, with the IRQs disabled by the caller. Between
+// the bytes the line stays low only for the call (~3us), no WS2812B takes that as a reset.
+// The CodeVisionAVR allocates the `data` parameter into the R16 register variable
+// (same ABI trick as the old 12-bit driver), the R31 is free to use in the assembly.
+void neopixelSendByte(uint8_t data) {
+#ifdef HOST_SIM
+  // The simulator can't run the assembly below, it steps through its instructions instead, the
+  // same path for the bit's value, and counts their cycles. The pin changes at the end of an SBI/CBI.
+  uint8_t i, cycles, high;
+
+  for (i = 0; i < 8; i++) {
+    cycles = NEOPIXEL_SBI + NEOPIXEL_W1;                    // sbi PB2, W1 nops
+    high   = 0;
+    if (data & 0x80) {
+      cycles += NEOPIXEL_SBRS_SKIP;                         // sbrs skips the cbi
+    } else {
+      cycles += NEOPIXEL_SBRS + NEOPIXEL_CBI;               // sbrs, cbi PB2 (the end of a '0')
+      high    = cycles - NEOPIXEL_SBI;
     }
-          
-    neopixelUpdate = 0;
+    cycles += NEOPIXEL_W2 + NEOPIXEL_LSL + NEOPIXEL_CBI;    // W2 nops, lsl, cbi PB2 (the end of a '1')
+    if (!high) high = cycles - NEOPIXEL_SBI;
+    cycles += NEOPIXEL_W3 + NEOPIXEL_DEC + ((i < 7) ? NEOPIXEL_BRNE_TAKEN : NEOPIXEL_BRNE); // W3 nops, dec, brne
+    halHostWs2812bBit(high, cycles);
+    data <<= 1;
+  }
+#else
+  #asm
+    ldi  r31, 8      // counter=8 (8 bits to count down)
+  _neo_bit:
+    sbi  0x5, 2      // PB2 = 1
+  #endasm
+#if NEOPIXEL_W1 & 1
+  #asm("nop")
+#endif
+#if NEOPIXEL_W1 & 2
+  #asm("nop\nnop")
+#endif
+#if NEOPIXEL_W1 & 4
+  #asm("nop\nnop\nnop\nnop")
+#endif
+#if NEOPIXEL_W1 & 8
+  #asm("nop\nnop\nnop\nnop\nnop\nnop\nnop\nnop")
+#endif
+  #asm
+    sbrs r16, 7      // Skip the next instruction if the MSB is 1
+    cbi  0x5, 2      // PB2 = 0, end of a '0' bit
+  #endasm
+#if NEOPIXEL_W2 & 1
+  #asm("nop")
+#endif
+#if NEOPIXEL_W2 & 2
+  #asm("nop\nnop")
+#endif
+#if NEOPIXEL_W2 & 4
+  #asm("nop\nnop\nnop\nnop")
+#endif
+#if NEOPIXEL_W2 & 8
+  #asm("nop\nnop\nnop\nnop\nnop\nnop\nnop\nnop")
+#endif
+  #asm
+    lsl  r16         // Next bit into the MSB
+    cbi  0x5, 2      // PB2 = 0, end of a '1' bit (no change for a '0' bit)
+  #endasm
+#if NEOPIXEL_W3 & 1
+  #asm("nop")
+#endif
+#if NEOPIXEL_W3 & 2
+  #asm("nop\nnop")
+#endif
+#if NEOPIXEL_W3 & 4
+  #asm("nop\nnop\nnop\nnop")
+#endif
+#if NEOPIXEL_W3 & 8
+  #asm("nop\nnop\nnop\nnop\nnop\nnop\nnop\nnop")
+#endif
+  #asm
+    dec  r31         // counter--
+    brne _neo_bit    // Next bit
+  #endasm
+#endif
+}
+
+
+// Send the whole pixel buffer with the IRQs disabled, an ISR between two LEDs would be long enough
+// to latch the frame and the rest would go to the first LED again. The vfdPause starts it in
+// a blanked part of a VFD slot and holds the refresh there, so no slot edge is missed. PB2 stays
+// low afterwards, which latches the colors.
+void neopixelShow(void) {
+  uint8_t i;
+
+  vfdPause();
+  profileBegin(PROFILE_NEOPIXEL);                           // Only the time the IRQs wait, not the ones they run after it
+  for (i = 0; i < NEOPIXEL_COUNT * 3; i++) {
+    neopixelSendByte(neopixelPixels[i]);
   }
+  profileEnd(PROFILE_NEOPIXEL);
+  vfdResume();
 }
 
 
-// Set color of one Neopixel WS2812B LED.
-// Hardcoded to PB2 pin and timed exactly for an 8MHz clock.
-// 12-bit colors instead of 24-bit, (4-bit for each channel, each bit is transmitted twice). 
-// Order of colors: Blue Red Green (0xBRG)
-// MSB is first in the stream, this means that 0x001 will be a brighter green than 0x008
-// CodeVisionAVR compiler doesn't support good mixing of C and ASM and
-// had to hardcode registers for its ABI. While rewriting  this into GCC
-// and its "Extended assembly" would make it more portable and robust.
-void neopixelSetColor(uint16_t color) {
-  #asm 
-    cli              // Disable IRQ
-    ldi  r31, 12     // counter=12  (12 bits to count down), the ABI promising R31 is free to use in assembly
-    lsr  r17         // color = color >> 1    hardcoding R16 and R17 for CodeVisionAVR ABI :( 
-    ror  r16    
-    brcc _bit_low    // If the bit shifted from color is 0 then push the low bits, otherwise push the high bits 
-       
-  _bit_high:
-    sbi  0x5, 2      // PB2 = 1
-    nop              // Timing NOPs
-    nop
-    nop  
-    lsr  r17         // Shift the color bits again, sooner than it's needed (because later there will be no time) 
-    ror  r16
-    dec  r31         // counter--; it doesn't touch the CARRY, so both decrement and right shift are safe to do ahead of time    
-    cbi  0x5, 2      // PB2 = 0
-    nop           
-    nop 
-    sbi  0x5, 2      // PB2 = 1 (each bit is pushed twice)   
-    nop
-    nop
-    nop
-    breq _neo_end    // If (0==counter) then end this loop (the end of the loop will do CBI anyway, so it's safe to do it ahead of time)
-    nop 
-    cbi  0x5, 2      // PB2 = 0 (but instead of timing NOPs do some decisions)
-    brcc _bit_low    // If the carry from the shifted bit from the color was 0 then go to the low bit branch,
-    rjmp _bit_high   // otherwise repeat this high bit branch
-                     
-  _bit_low:
-    sbi  0x5, 2      // PB2 = 1
-    nop              // Timing NOP
-    cbi  0x5, 2      // PB2 = 0
-    nop 
-    nop 
-    lsr  r17         // Shift the color bits again, sooner than it's needed (because later there will be no time) 
-    ror  r16
-    dec  r31         // counter--; it doesn't touch the CARRY, so both decrement and right shift are safe to do ahead of time
-    sbi  0x5, 2      // PB2 = 1 (each bit is pushed twice)   
-    nop              // Timing NOP
-    cbi  0x5, 2      // PB2 = 0
-    nop
-    nop 
-    breq _neo_end    // If (0==counter) then end this loop
-    brcc _bit_low    // If the carry from the shifted bit from the color was 0 then repeat this low bit branch,
-    rjmp _bit_high   // otherwise go to the high bit branch
-      
-  _neo_end:      
-    cbi  0x5,2       // PB2 = 0 as it might not have been set yet
-                     // Leave it at 0 as that will send the WS2812B chip a 'reset' command which will start displaying the color
-                    
-    sei              // enable IRQs
-  #endasm
+// Colors are given as 0xRRGGBB, but the WS2812B expects them as Green Red Blue
+void neopixelSetPixel(uint8_t index, uint32_t color) {
+  uint8_t *pixel = &neopixelPixels[index * 3];
+
+  pixel[0] = (uint8_t)(color >> 8);
+  pixel[1] = (uint8_t)(color >> 16);
+  pixel[2] = (uint8_t)color;
 }
 
 
+void neopixelSetColor(uint32_t color) {
+  uint8_t i;
+
+  for (i = 0; i < NEOPIXEL_COUNT; i++) {
+    neopixelSetPixel(i, color);
+  }
+  neopixelShow();
+}
@@ -0,0 +1,91 @@
+#ifndef SMARTWATCH_PINS_H
+#define SMARTWATCH_PINS_H
+
+#include "hal.h"        // halPinHigh/Low/Read
+
+// Every pin of the watch is a `port, bit` pair, the pin operations below take the name
+// and expand it into the hal.h macros. With constant pins they compile into a single
+// SBI/CBI/SBIC instruction, there is no function to call and nothing to inline.
+//
+//   pinHigh(PIN_FILAMENT);   ->   PORTB |= (1 << 1);
+
+#define PIN_UART_RXD       D, 0  // RXD0 of the command channel, internal pull-up, PCINT16 (only while sleeping)
+#define PIN_UART_TXD       D, 1  // TXD0 of the command channel, internal pull-up (an idle line) while the transmitter is off
+#define PIN_BUTTON         D, 2  // WAKE-UP button, externally pulled up (~1M), PCINT18
+#define PIN_RTC_SQW        D, 3  // DS3231's ~INT/SQW open drain, internal pull-up, PCINT19
+#define PIN_DC2DC          D, 4  // VFD's high-voltage DC2DC boost converter enable (wired to the PD1 on the schematic)
+#define PIN_MOTOR          D, 5  // Vibration motor's transistor, high = vibrating
+#define PIN_VFD_LOAD       D, 7  // MAX6920AWP's LOAD
+#define PIN_FILAMENT       B, 1  // VFD's low-voltage filament heater
+#define PIN_NEOPIXEL       B, 2  // WS2812B data (it's the SPI's SS as well, so it has to stay an output)
+#define PIN_SPI_MOSI       B, 3  // MAX6920AWP's DIN
+#define PIN_SPI_SCK        B, 5  // MAX6920AWP's CLK
+#define PIN_TWI_SDA        C, 4  // DS3231M, external pull-ups
+#define PIN_TWI_SCL        C, 5
+
+
+// The extra level of the macros makes the preprocessor split the pin name into the `port, bit`
+#define pinHigh(pin)       PIN_HIGH_(pin)
+#define pinLow(pin)        PIN_LOW_(pin)
+#define pinRead(pin)       PIN_READ_(pin)
+#define pinMask(pin)       PIN_MASK_(pin)         // Bit of the pin in its PORTx/DDRx/PINx (and PCMSKx)
+#define pinInputs(pin)     PIN_INPUTS_(pin)       // The whole PINx register the pin is in
+#define pinIsOn(pin, port) PIN_IS_ON_(pin, port)  // Constant expression, for the static asserts
+
+#define PIN_HIGH_(port, bit)        halPinHigh(port, bit)
+#define PIN_LOW_(port, bit)         halPinLow(port, bit)
+#define PIN_READ_(port, bit)        halPinRead(port, bit)
+#define PIN_MASK_(port, bit)        (1 << (bit))
+#define PIN_INPUTS_(port, bit)      PIN##port
+#define PIN_IS_ON_(port, bit, want) (PIN_PORT_##port == PIN_PORT_##want)
+
+#define PIN_PORT_B         0
+#define PIN_PORT_C         1
+#define PIN_PORT_D         2
+
+
+// Initial state of the ports, everything not listed is a tri-stated input
+#define PINS_OUTPUTS_B     (pinMask(PIN_FILAMENT) | pinMask(PIN_NEOPIXEL) | pinMask(PIN_SPI_MOSI) | pinMask(PIN_SPI_SCK))
+#define PINS_OUTPUTS_C     0
+#define PINS_OUTPUTS_D     (pinMask(PIN_DC2DC) | pinMask(PIN_MOTOR) | pinMask(PIN_VFD_LOAD))
+#define PINS_PULLUPS_D     (pinMask(PIN_UART_RXD) | pinMask(PIN_UART_TXD) | pinMask(PIN_RTC_SQW))
+
+// The pin change IRQ 2 (PCINT16-23 are the PD0-7)
+#define PINS_PCINT2        (pinMask(PIN_BUTTON) | pinMask(PIN_RTC_SQW))
+
+
+// The assignments above are checked by the preprocessor, a wrong port or
+// two functions on the same pin fail the build instead of the hardware
+#if !(pinIsOn(PIN_FILAMENT, B) && pinIsOn(PIN_NEOPIXEL, B) && pinIsOn(PIN_SPI_MOSI, B) && pinIsOn(PIN_SPI_SCK, B))
+#error "The PINS_OUTPUTS_B lists a pin which is not on the port B"
+#endif
+
+#if !(pinIsOn(PIN_UART_RXD, D) && pinIsOn(PIN_UART_TXD, D) && pinIsOn(PIN_DC2DC, D) && pinIsOn(PIN_MOTOR, D) && pinIsOn(PIN_VFD_LOAD, D) && pinIsOn(PIN_BUTTON, D) && pinIsOn(PIN_RTC_SQW, D))
+#error "The PINS_OUTPUTS_D, PINS_PULLUPS_D or PINS_PCINT2 list a pin which is not on the port D"
+#endif
+
+#if !(pinIsOn(PIN_TWI_SDA, C) && pinIsOn(PIN_TWI_SCL, C) && pinMask(PIN_TWI_SDA) == (1 << 4) && pinMask(PIN_TWI_SCL) == (1 << 5))
+#error "The TWI module is hardwired to the PC4 and PC5"
+#endif
+
+#if (pinMask(PIN_FILAMENT) + pinMask(PIN_NEOPIXEL) + pinMask(PIN_SPI_MOSI) + pinMask(PIN_SPI_SCK)) != PINS_OUTPUTS_B
+#error "Two functions are assigned to the same pin of the port B"
+#endif
+
+#if (pinMask(PIN_UART_RXD) + pinMask(PIN_UART_TXD) + pinMask(PIN_DC2DC) + pinMask(PIN_BUTTON) + pinMask(PIN_RTC_SQW) + pinMask(PIN_MOTOR) + pinMask(PIN_VFD_LOAD)) != (PINS_OUTPUTS_D | PINS_PULLUPS_D | PINS_PCINT2)
+#error "Two functions are assigned to the same pin of the port D"
+#endif
+
+#if pinMask(PIN_UART_RXD) != (1 << 0) || pinMask(PIN_UART_TXD) != (1 << 1)
+#error "The USART0 is hardwired to the PD0 (RXD0) and PD1 (TXD0)"
+#endif
+
+#if !(PINS_OUTPUTS_B & (1 << 2))
+#error "The SPI master falls back into the slave mode when its SS (PB2) is an input pulled low"
+#endif
+
+#if pinMask(PIN_SPI_MOSI) != (1 << 3) || pinMask(PIN_SPI_SCK) != (1 << 5)
+#error "The SPI module is hardwired to the PB3 (MOSI) and PB5 (SCK)"
+#endif
+
+#endif
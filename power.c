@@ -0,0 +1,43 @@
+#include <stdint.h>  // `uint8_t` and `uint16_t`
+
+#include "hal.h"     // AVR Mega88 PA and power managment (or their simulation)
+#include "power.h"
+
+
+uint8_t powerUsers[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };  // Indexed by the PRR bit
+
+
+void powerInit(void) {
+  uint8_t gated = 0;
+  uint8_t i;
+
+  for (i = 0; i < 8; i++) {
+    if (!powerUsers[i]) gated |= (1 << i);
+  }
+  PRR = gated & POWER_MODULES;
+}
+
+
+void powerAcquire(uint8_t module) {
+  uint8_t interrupts = halInterruptsSave();
+
+  halInterruptsDisable();
+  if (0 == powerUsers[module]++) PRR &= ~(1 << module);
+  halInterruptsRestore(interrupts);
+}
+
+
+void powerRelease(uint8_t module) {
+  uint8_t interrupts = halInterruptsSave();
+
+  halInterruptsDisable();
+  if (powerUsers[module] && 0 == --powerUsers[module]) PRR |= (1 << module);
+  halInterruptsRestore(interrupts);
+}
+
+
+// The BOD draws ~20uA, in the power-down that's more than the whole MCU. Nothing can brown out
+// while the CPU doesn't run, the BOD is enabled again by the wake-up (which takes 60us longer).
+void powerDown(void) {
+  halPowerDown();
+}
@@ -0,0 +1,30 @@
+#ifndef SMARTWATCH_POWER_H
+#define SMARTWATCH_POWER_H
+
+#include <stdint.h> // `uint8_t` and `uint16_t`
+
+// Clocks of the on-chip modules. Each module has a counter of its users, the drivers acquire
+// it before touching its registers and release it when done, the last release gates its clock
+// in the PRR. A gated module keeps its registers frozen and can't be read or written.
+//
+// The watch sleeps >99% of the time, so the power-down itself is the most important state,
+// the powerDown() turns off the brown-out detector for its duration as well.
+
+// Modules, the values are their bits in the PRR
+#define POWER_ADC      PRADC
+#define POWER_USART0   PRUSART0
+#define POWER_SPI      PRSPI
+#define POWER_TIMER1   PRTIM1
+#define POWER_TIMER0   PRTIM0
+#define POWER_TIMER2   PRTIM2
+#define POWER_TWI      PRTWI
+#define POWER_MODULES  ((1 << POWER_ADC) | (1 << POWER_USART0) | (1 << POWER_SPI) | (1 << POWER_TIMER1) | \
+                        (1 << POWER_TIMER0) | (1 << POWER_TIMER2) | (1 << POWER_TWI))  // The bit 4 is reserved, written 0
+
+
+extern void powerInit(void);             // Gate every module nobody acquired yet (after the setup of their registers)
+extern void powerAcquire(uint8_t module); // Clock the module, safe to call from the IRQs
+extern void powerRelease(uint8_t module); // Gate it once its last user released it, safe to call from the IRQs
+extern void powerDown(void);             // Power-down with the BOD off, until the WAKE-UP button
+
+#endif
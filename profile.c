@@ -0,0 +1,86 @@
+#include <stdint.h>  // `uint8_t` and `uint16_t`
+
+#include "hal.h"     // AVR Mega88 PA (or its simulation)
+#include "power.h"
+#include "profile.h"
+
+#if PROFILE
+
+#if HAL_F_CPU / 8 != 1000000UL * PROFILE_TICK_US
+#error "The Timer2's clk/8 has to make the PROFILE_TICK_US"
+#endif
+
+
+profileRegion    profileRegions[PROFILE_REGIONS];
+uint16_t         profileStarts[PROFILE_REGIONS];
+volatile uint8_t profileOverflows = 0;      // Upper byte of the time
+
+
+// Timer2 overflow interrupt service routine, every 256us
+HAL_ISR(TIM2_OVF) void timer2_ovf_isr(void) {
+  profileOverflows++;
+}
+
+
+void profileInit(void) {
+  profileClear();
+  powerAcquire(POWER_TIMER2);
+  TCCR2A = (0<<COM2A1) | (0<<COM2A0) | (0<<COM2B1) | (0<<COM2B0) | (0<<WGM21) | (0<<WGM20);
+  TCCR2B = (0<<WGM22) | (0<<CS22) | (1<<CS21) | (0<<CS20);
+  TIMSK2 = (0<<OCIE2B) | (0<<OCIE2A) | (1<<TOIE2);
+}
+
+
+// The overflow which happened since the IRQs were disabled is not counted yet, but then the
+// TCNT2 has to be small, a large TCNT2 was read before the overflow
+uint16_t profileNow(void) {
+  uint8_t interrupts = halInterruptsSave();
+  uint8_t high, low;
+
+  halInterruptsDisable();
+  high = profileOverflows;
+  low  = TCNT2;
+  if ((TIFR2 & (1 << TOV2)) && low < 0x80) high++;
+  halInterruptsRestore(interrupts);
+  return ((uint16_t)high << 8) | low;
+}
+
+
+// A region is recorded either by the super loop or by one ISR, never by both, so no locking
+void profileRecord(uint8_t region, uint16_t ticks) {
+  profileRegion *stats  = &profileRegions[region];
+  uint16_t       limit  = PROFILE_FIRST_BUCKET;
+  uint8_t        bucket = 0;
+
+  uint8_t        i;
+
+  if (!stats->count || ticks < stats->min) stats->min = ticks;
+  if (ticks > stats->max)                  stats->max = ticks;
+
+  while (bucket < PROFILE_BUCKETS - 1 && ticks >= limit) {
+    bucket++;
+    limit <<= 2;
+  }
+
+  // The VFD's slots fill a bucket in 16s, halving keeps the shape of the histogram (and the
+  // count its sum), the rare buckets which drop to 0 have the max to tell they happened
+  if (0xFFFF == stats->count) {
+    stats->count = 0;
+    for (i = 0; i < PROFILE_BUCKETS; i++) {
+      stats->buckets[i] >>= 1;
+      stats->count       += stats->buckets[i];
+    }
+  }
+  stats->count++;
+  stats->buckets[bucket]++;
+}
+
+
+void profileClear(void) {
+  uint8_t *stats = (uint8_t *)profileRegions;
+  uint16_t i;
+
+  for (i = 0; i < sizeof(profileRegions); i++) stats[i] = 0;
+}
+
+#endif
@@ -0,0 +1,74 @@
+#ifndef SMARTWATCH_PROFILE_H
+#define SMARTWATCH_PROFILE_H
+
+#include <stdint.h> // `uint8_t` and `uint16_t`
+
+// Cycle profiler of the named regions, compiled in only with the PROFILE defined to 1 (the host
+// simulator is built with it), otherwise all its macros expand to nothing.
+//
+// The Timer2 runs freely at the clk/8 (1us ticks at 8MHz) and its overflow IRQ counts the upper
+// byte, so a region can be up to 65ms long. The overflow IRQ costs ~1.5% of the CPU while awake,
+// the Timer2 stops in the power-down as all the synchronous timers do. A region's time is taken
+// from the profileBegin to its profileEnd, so the ISRs which nested inside count too (that's
+// exactly the jitter the refresh sees). Each region keeps its count, the shortest and the longest
+// time, and a histogram with buckets growing 4 times: <4us, <16us, <64us ... <16ms, the rest.
+//
+// The regions of the ISRs don't include the CodeVisionAVR's register saving and restoring (~5us).
+
+#ifndef PROFILE
+#define PROFILE 0
+#endif
+
+#define PROFILE_TICK_US       1
+#define PROFILE_BUCKETS       8
+#define PROFILE_FIRST_BUCKET  4     // Ticks, each next bucket is 4 times longer
+
+// Regions
+#define PROFILE_LOOP          0     // One pass of the super loop without its sleep
+#define PROFILE_DISPLAY       1     // displayTime, the frame is committed with the IRQs disabled
+#define PROFILE_RTC_READ      2     // From the rtcRefresh to the burst arriving (TWI in the background)
+#define PROFILE_ANIMATION     3     // One frame of the Neopixel fade
+#define PROFILE_NEOPIXEL      4     // The whole frame to the WS2812B chain with the IRQs disabled
+#define PROFILE_REFRESH       5     // Period of the VFD slots, the start of one to the start of the next
+#define PROFILE_ISR_SLOT      6     // timer0_compa_isr, the next character's word and the filament PWM
+#define PROFILE_ISR_SCHED     7     // timer1_compa_isr
+#define PROFILE_ISR_INPUT     8     // pin_change_isr2, the button and the square wave
+#define PROFILE_ISR_SPI       9     // spi_isr
+#define PROFILE_ISR_TWI       10    // twi_isr
+#define PROFILE_REGIONS       11
+
+// For the tools on the host which print the profiles
+#define PROFILE_NAMES "loop", "displayTime", "rtcRead", "animation", "neopixelFrame", "vfdSlotPeriod", \
+                      "isrVfdSlot", "isrSched", "isrInput", "isrSpi", "isrTwi"
+
+// The layout is sent over the UART as it is (little-endian, no padding)
+typedef struct {
+  uint16_t count;                     // Sum of the buckets, all are halved when it would overflow
+  uint16_t min;
+  uint16_t max;
+  uint16_t buckets[PROFILE_BUCKETS];
+} profileRegion;
+
+
+#if PROFILE
+
+extern profileRegion profileRegions[PROFILE_REGIONS];
+extern uint16_t      profileStarts[PROFILE_REGIONS];
+
+#define profileBegin(region)  profileStarts[region] = profileNow()
+#define profileEnd(region)    profileRecord(region, profileNow() - profileStarts[region])
+
+extern void     profileInit(void);                             // Start the Timer2
+extern uint16_t profileNow(void);                              // Ticks of the free running time, safe to call from the IRQs
+extern void     profileRecord(uint8_t region, uint16_t ticks); // Add one measurement
+extern void     profileClear(void);                            // Start all the statistics again
+
+#else
+
+#define profileBegin(region)
+#define profileEnd(region)
+#define profileInit()
+
+#endif
+
+#endif
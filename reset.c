@@ -1,10 +1,17 @@
-#include <mega88a.h>    // AVR Mega88 PA
-#include <twi.h>        // TWI functions (I2C)
-#include <ds3231_twi.h> // DS3231 Real Time Clock functions for TWI(I2C)
-#include <sleep.h>      // Power managment
-
+#include "hal.h"        // AVR Mega88 PA and power managment (or their simulation)
+#include "pins.h"
 #include "reset.h"
 #include "vfd.h"
+#include "twim.h"
+#include "rtc.h"
+#include "power.h"
+#include "uart.h"
+
+
+// The MAX6920AWP shifts at most 5MHz, the SPI runs at the F_CPU/4
+#if HAL_F_CPU / 4 > 5000000
+#error "The SPI clock is too fast for the MAX6920AWP, use a bigger SPI divider"
+#endif
 
 
 // Set all the internal peripherals of the ATmega88PA with an 8MHz clock into a good known state
@@ -17,60 +24,54 @@ void systemPeripheralsSetup(void) {
   #pragma optsize+
   #endif
                    
-  // -------- Port B initialization --------  
-  //     In            In            Out           In            Out           Out           Out           In
-  DDRB= (0<<DDB7)   | (0<<DDB6)   | (1<<DDB5)   | (0<<DDB4)   | (1<<DDB3)   | (1<<DDB2)   | (1<<DDB1)   | (0<<DDB0);        
-  //     T             T             0             T             T             0             0             T 
-  PORTB=(0<<PORTB7) | (0<<PORTB6) | (0<<PORTB5) | (0<<PORTB4) | (0<<PORTB3) | (0<<PORTB2) | (0<<PORTB1) | (0<<PORTB0);
-
-  // --------  Port C initialization -------- 
-  //     In            In            In            In            In            In            In
-  DDRC= (0<<DDC6)   | (0<<DDC5)   | (0<<DDC4)   | (0<<DDC3)   | (0<<DDC2)   | (0<<DDC1)   | (0<<DDC0);
-  //     T             T             T             T             T             T             T             
-  PORTC=(0<<PORTC6) | (0<<PORTC5) | (0<<PORTC4) | (0<<PORTC3) | (0<<PORTC2) | (0<<PORTC1) | (0<<PORTC0);  
-  
-  // -------- Port D initialization --------
-  //     Out           In            In            In            In            In            Out           In
-  DDRD= (1<<DDD7)   | (0<<DDD6)   | (0<<DDD5)   | (0<<DDD4)   | (0<<DDD3)   | (0<<DDD2)   | (1<<DDD1)   | (0<<DDD0);
-  //     0             T             T             T             T             T             0             T             
-  PORTD=(0<<PORTD7) | (0<<PORTD6) | (0<<PORTD5) | (0<<PORTD4) | (0<<PORTD3) | (0<<PORTD2) | (0<<PORTD1) | (0<<PORTD0);
-
-  // Timer/Counter 0 initialization
+  // -------- Ports initialization --------
+  // The directions, pull-ups and the pin change mask come from the pin assignment in the pins.h,
+  // everything else is a tri-stated input. All outputs start low (VFD, its power and filament off).
+  DDRB  = PINS_OUTPUTS_B;
+  PORTB = 0;
+  DDRC  = PINS_OUTPUTS_C;
+  PORTC = 0;
+  DDRD  = PINS_OUTPUTS_D;
+  PORTD = PINS_PULLUPS_D;
+
+  // Timer/Counter 0 initialization, multiplexing of the VFD characters
   // Clock source: System Clock
-  // Clock value: Timer 0 Stopped
-  // Mode: Normal top=0xFF
+  // Clock value: Timer 0 Stopped (started by vfdOn() with 1000.000 kHz)
+  // Mode: CTC top=OCR0A
   // OC0A output: Disconnected
   // OC0B output: Disconnected
-  TCCR0A=(0<<COM0A1) | (0<<COM0A0) | (0<<COM0B1) | (0<<COM0B0) | (0<<WGM01) | (0<<WGM00);
+  // Timer Period: 0.25 ms (one character slot)
+  TCCR0A=(0<<COM0A1) | (0<<COM0A0) | (0<<COM0B1) | (0<<COM0B0) | (1<<WGM01) | (0<<WGM00);
   TCCR0B=(0<<WGM02) | (0<<CS02) | (0<<CS01) | (0<<CS00);
   TCNT0=0x00;
-  OCR0A=0x00;
-  OCR0B=0x00;
+  OCR0A=VFD_SLOT_TICKS - 1;
+  OCR0B=VFD_MIN_ON_TICKS;
 
 
-  // Timer/Counter 1 initialization
+  // Timer/Counter 1 initialization, time base of the scheduler
   // Clock source: System Clock
-  // Clock value: 7.813 kHz
-  // Mode: CTC top=OCR1A
+  // Clock value: 7.813 kHz (128us ticks)
+  // Mode: Normal top=0xFFFF
   // OC1A output: Disconnected
   // OC1B output: Disconnected
   // Noise Canceler: Off
   // Input Capture on Falling Edge
-  // Timer Period: 50.048 ms
-  // Timer1 Overflow Interrupt: Off
+  // Timer Period: 8.389 s
+  // Timer1 Overflow Interrupt: On, upper 16 bits of the time
   // Input Capture Interrupt: Off
-  // Compare A Match Interrupt: On
+  // Compare A Match Interrupt: On, moved to the nearest deadline by the schedSleep()
   // Compare B Match Interrupt: Off
   TCCR1A=(0<<COM1A1) | (0<<COM1A0) | (0<<COM1B1) | (0<<COM1B0) | (0<<WGM11) | (0<<WGM10);
-  TCCR1B=(0<<ICNC1) | (0<<ICES1) | (0<<WGM13) | (1<<WGM12) | (1<<CS12) | (0<<CS11) | (1<<CS10);
+  TCCR1B=(0<<ICNC1) | (0<<ICES1) | (0<<WGM13) | (0<<WGM12) | (1<<CS12) | (0<<CS11) | (1<<CS10);
   TCNT1H=0x00;
   TCNT1L=0x00;
   ICR1H=0x00;
   ICR1L=0x00;
-  OCR1AH=0x01;
-  OCR1AL=0x86;
+  OCR1AH=0x00;
+  OCR1AL=0x00;
   OCR1BH=0x00;
   OCR1BL=0x00;
+  powerAcquire(POWER_TIMER1); // The scheduler's time base is needed whenever the CPU runs
   
 
   // Timer/Counter 2 initialization
@@ -87,10 +88,12 @@ void systemPeripheralsSetup(void) {
   OCR2B=0x00;
 
   // Timer/Counter 0 Interrupt(s) initialization
-  TIMSK0=(0<<OCIE0B) | (0<<OCIE0A) | (0<<TOIE0);
+  // Compare A Match Interrupt: On, start of the character slot
+  // Compare B Match Interrupt: On, end of the glowing part of the slot
+  TIMSK0=(1<<OCIE0B) | (1<<OCIE0A) | (0<<TOIE0);
 
   // Timer/Counter 1 Interrupt(s) initialization
-  TIMSK1=(0<<ICIE1) | (0<<OCIE1B) | (1<<OCIE1A) | (0<<TOIE1);
+  TIMSK1=(0<<ICIE1) | (0<<OCIE1B) | (1<<OCIE1A) | (1<<TOIE1);
 
   // Timer/Counter 2 Interrupt(s) initialization
   TIMSK2=(0<<OCIE2B) | (0<<OCIE2A) | (0<<TOIE2);
@@ -100,16 +103,16 @@ void systemPeripheralsSetup(void) {
   // INT1: Off
   // Interrupt on any change on pins PCINT0-7: Off
   // Interrupt on any change on pins PCINT8-14: Off
-  // Interrupt on any change on pins PCINT16-23: On the PCINT18/PD2 is the WAKE-UP button
+  // Interrupt on any change on pins PCINT16-23: On the WAKE-UP button and the DS3231's ~INT/SQW
   EICRA=(0<<ISC11) | (0<<ISC10) | (0<<ISC01) | (0<<ISC00);
   EIMSK=(0<<INT1) | (0<<INT0);
   PCICR=(1<<PCIE2) | (0<<PCIE1) | (0<<PCIE0);
-  PCMSK2=(0<<PCINT23) | (0<<PCINT22) | (0<<PCINT21) | (0<<PCINT20) | (0<<PCINT19) | (1<<PCINT18) | (0<<PCINT17) | (0<<PCINT16);
+  PCMSK2=PINS_PCINT2;
   PCIFR=(1<<PCIF2) | (0<<PCIF1) | (0<<PCIF0);
 
   // USART initialization
-  // USART disabled
-  UCSR0B=(0<<RXCIE0) | (0<<TXCIE0) | (0<<UDRIE0) | (0<<RXEN0) | (0<<TXEN0) | (0<<UCSZ02) | (0<<RXB80) | (0<<TXB80);
+  // Command channel: 38400 8N1, the receiver, the transmitter and their IRQs
+  uartInit();
 
   // Analog Comparator initialization
   // Analog Comparator: Off
@@ -124,7 +127,7 @@ void systemPeripheralsSetup(void) {
   DIDR1=(0<<AIN0D) | (0<<AIN1D);
 
   // ADC initialization
-  // ADC disabled
+  // ADC disabled, the battery monitor powers it only for its conversions
   ADCSRA=(0<<ADEN) | (0<<ADSC) | (0<<ADATE) | (0<<ADIF) | (0<<ADIE) | (0<<ADPS2) | (0<<ADPS1) | (0<<ADPS0);
 
   // SPI initialization to interact with MAX6920AWP and drive the VFD
@@ -134,24 +137,28 @@ void systemPeripheralsSetup(void) {
   // SPI Clock Phase: Cycle Start
   // SPI Clock Polarity: Low
   // SPI Data Order: MSB First
-  SPCR=(0<<SPIE) | (1<<SPE) | (0<<DORD) | (1<<MSTR) | (0<<CPOL) | (0<<CPHA) | (0<<SPR1) | (0<<SPR0);
+  // SPI Interrupt: On, the second byte and the LOAD pulse are done from the IRQ
+  SPCR=(1<<SPIE) | (1<<SPE) | (0<<DORD) | (1<<MSTR) | (0<<CPOL) | (0<<CPHA) | (0<<SPR1) | (0<<SPR0);
   SPSR=(0<<SPI2X);
 
   // TWI initialization to interact with DS3231M RTC I2C peripheral
-  // Mode: TWI Master
-  // Bit Rate: 100 kHz
-  twi_master_init(100);
+  // Mode: TWI Master, interrupt driven
+  // Bit Rate: 400 kHz
+  twimInit();
   
-  #asm("sei")       // Globally enable interrupts
-  sleep_enable();   // Enable power managment features
+  halInterruptsEnable(); // Globally enable interrupts
+  sleep_enable();         // Enable power managment features
 
   // DS3231 Real Time Clock initialization for TWI
-  // ~INT/SQW pin function: Disabled
+  // ~INT/SQW pin function: 1Hz square wave, open drain pulled up by the PD3, keeps the seconds
   // 32 kHz pin output: Off
-  rtc_init(DS3231_INT_SQW_OFF,0);
+  rtcInit(RTC_SQW_1HZ);
                    
-  // Power on the VFD but make sure it doesn't display anything yet
-  sendDataToVfd(0);  
+  // Start powering the VFD, the refresh starts from the super loop (the frame buffer is blank until then anyway)
   vfdOn();
+
+  // Gate the clocks of the modules nobody uses right now: the Timer2 is not used at all,
+  // the SPI and the Timer0 are acquired with the VFD refresh, the ADC by the battery monitor
+  powerInit();
 }
 
@@ -0,0 +1,142 @@
+#include <stdint.h>  // `uint8_t` and `uint16_t`
+
+#include "hal.h"     // AVR Mega88 PA (or its simulation)
+#include "twim.h"
+#include "rtc.h"
+#include "sched.h"
+#include "profile.h"
+
+
+uint8_t      rtcConfig[3];                      // Control and status registers
+uint8_t      rtcTime[4];                        // Seconds, minutes and hours
+uint8_t      rtcBurst[1 + RTC_REGISTERS];       // Register address followed by all the registers
+uint8_t      rtcAlarm[5];                       // Register address followed by an alarm
+twimTransfer rtcConfigTransfer = { RTC_ADDRESS, sizeof(rtcConfig), 0,             rtcConfig, TWIM_IDLE, 0 };
+twimTransfer rtcTimeTransfer   = { RTC_ADDRESS, sizeof(rtcTime),   0,             rtcTime,   TWIM_IDLE, 0 };
+twimTransfer rtcAlarmTransfer  = { RTC_ADDRESS, sizeof(rtcAlarm),  0,             rtcAlarm,  TWIM_IDLE, 0 };
+twimTransfer rtcReadTransfer   = { RTC_ADDRESS, 1,                 RTC_REGISTERS, rtcBurst,  TWIM_IDLE, SCHED_RTC };
+uint8_t      rtcRegisters[RTC_REGISTERS];
+
+
+uint8_t rtcToBcd(uint8_t value) {
+  uint8_t tens = 0;
+
+  while (value >= 10) {                         // The values are below 60, cheaper than a division
+    value -= 10;
+    tens++;
+  }
+  return (tens << 4) | value;
+}
+
+
+uint8_t rtcFromBcd(uint8_t value) {
+  return (value >> 4) * 10 + (value & 0x0F);
+}
+
+
+// Each transfer has its own buffer, so the callers wait for their previous transfer to leave
+// the queue before touching the buffer. That happens only when the same request is repeated
+// within a few hundred microseconds, the queue being full is just as rare.
+// The full queue is checked again with the IRQs disabled, as in the twimWait.
+void rtcSubmit(twimTransfer *transfer) {
+  while (!twimSubmit(transfer)) {
+    halInterruptsDisable();
+    if (twimFull()) halSleepIdle();
+    else            halInterruptsEnable();
+  }
+}
+
+
+void rtcInit(uint8_t control) {
+  twimWait(&rtcConfigTransfer);
+  rtcConfig[0] = RTC_CONTROL;
+  rtcConfig[1] = control;
+  rtcConfig[2] = RTC_OSF;                       // Clear the alarm flags, no 32kHz output, the OSF is kept (it's cleared by writing 0)
+  rtcSubmit(&rtcConfigTransfer);
+}
+
+
+// Writing the seconds register restarts the RTC's countdown chain
+void rtcSetTime(uint8_t hour, uint8_t minute, uint8_t second) {
+  twimWait(&rtcTimeTransfer);
+  rtcTime[0] = RTC_SECONDS;
+  rtcTime[1] = rtcToBcd(second);
+  rtcTime[2] = rtcToBcd(minute);
+  rtcTime[3] = rtcToBcd(hour);                  // 24-hour mode
+  rtcSubmit(&rtcTimeTransfer);
+
+  // The time is valid now, clear the oscillator stop flag (the control register is written again as it was)
+  twimWait(&rtcConfigTransfer);
+  rtcConfig[2] = 0x00;
+  rtcSubmit(&rtcConfigTransfer);
+}
+
+
+void rtcWait(void) {
+  twimWait(&rtcConfigTransfer);
+}
+
+
+// The alarm 1 is the one with the seconds, all its mask bits are 0 except the AxM4
+void rtcSetAlarm1(uint8_t hour, uint8_t minute) {
+  twimWait(&rtcAlarmTransfer);
+  rtcAlarm[0] = RTC_ALARM1;
+  rtcAlarm[1] = 0x00;                           // Seconds
+  rtcAlarm[2] = rtcToBcd(minute);
+  rtcAlarm[3] = rtcToBcd(hour);
+  rtcAlarm[4] = RTC_ALARM_DAILY;
+  rtcAlarmTransfer.writeLength = 5;
+  rtcSubmit(&rtcAlarmTransfer);
+}
+
+
+// The DS3231 keeps the alarm registers on its backup supply, so the `tag` is a free place for the alarm's settings
+void rtcSetAlarm2(uint8_t hour, uint8_t minute, uint8_t tag) {
+  twimWait(&rtcAlarmTransfer);
+  rtcAlarm[0] = RTC_ALARM2;
+  rtcAlarm[1] = rtcToBcd(minute);
+  rtcAlarm[2] = rtcToBcd(hour);
+  rtcAlarm[3] = RTC_ALARM_DAILY | (tag & 0x3F);
+  rtcAlarmTransfer.writeLength = 4;
+  rtcSubmit(&rtcAlarmTransfer);
+}
+
+
+// One burst from the address 0x00 to the temperature, the registers are latched by the DS3231
+// at the start of the read, so the time can't roll over between the bytes
+void rtcRefresh(void) {
+  twimWait(&rtcReadTransfer);
+  rtcBurst[0] = RTC_SECONDS;
+  profileBegin(PROFILE_RTC_READ);
+  rtcSubmit(&rtcReadTransfer);
+}
+
+
+uint8_t rtcReady(void) {
+  uint8_t i;
+
+  if (TWIM_ERROR == rtcReadTransfer.status) rtcRefresh(); // Retry, the DS3231 didn't respond
+  if (TWIM_DONE  != rtcReadTransfer.status) return 0;
+  profileEnd(PROFILE_RTC_READ);
+  for (i = 0; i < RTC_REGISTERS; i++) rtcRegisters[i] = rtcBurst[1 + i];
+  rtcReadTransfer.status = TWIM_IDLE;           // Copied, the next call reports only a new burst
+  return 1;
+}
+
+
+// The DS3231 converts every 64s on its own, the MSB is two's complement whole degrees
+int8_t rtcTemperature(void) {
+  return (int8_t)rtcRegisters[RTC_TEMPERATURE];
+}
+
+
+void rtcGetTime(uint8_t *hour, uint8_t *minute, uint8_t *second) {
+  *second = rtcFromBcd(rtcRegisters[RTC_SECONDS] & 0x7F);
+  *minute = rtcFromBcd(rtcRegisters[RTC_MINUTES] & 0x7F);
+  *hour   = rtcFromBcd(rtcRegisters[RTC_HOURS]   & 0x3F);
+}
+
+
+uint8_t rtcTimeLost(void) {
+  return rtcRegisters[RTC_STATUS] & RTC_OSF;
+}
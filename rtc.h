@@ -0,0 +1,49 @@
+#ifndef SMARTWATCH_RTC_H
+#define SMARTWATCH_RTC_H
+
+#include <stdint.h> // `uint8_t` and `uint16_t`
+
+// DS3231M real time clock client on top of the interrupt driven TWI master
+
+#define RTC_ADDRESS       0x68  // 7-bit TWI address of the DS3231M
+#define RTC_REGISTERS     0x13  // Time, date, alarms, control, status, aging and temperature
+
+// Register addresses
+#define RTC_SECONDS       0x00
+#define RTC_MINUTES       0x01
+#define RTC_HOURS         0x02
+#define RTC_ALARM1        0x07  // Seconds, minutes, hours, day/date
+#define RTC_ALARM2        0x0B  // Minutes, hours, day/date
+#define RTC_CONTROL       0x0E
+#define RTC_STATUS        0x0F
+#define RTC_TEMPERATURE   0x11  // MSB in whole degrees, the 0x12 has the fraction in the top 2 bits
+
+// Control register values
+#define RTC_INT_SQW_OFF   0x04  // INTCN=1 and no alarm enabled, the ~INT/SQW pin stays high
+#define RTC_SQW_1HZ       0x00  // INTCN=0, RS2:1=00
+#define RTC_INTCN         0x04  // The ~INT/SQW is the alarm interrupt, low while an enabled alarm's flag is set
+#define RTC_A1IE          0x01  // Alarm 1 pulls the ~INT low (with the INTCN)
+#define RTC_A2IE          0x02
+
+// Alarm registers
+#define RTC_ALARM_DAILY   0x80  // AxM4 in the day/date register, match the time every day (the date bits are ignored)
+
+// Status register
+#define RTC_OSF           0x80  // Oscillator stopped (first power-up or the supply was lost), the time is not valid
+
+
+extern uint8_t rtcRegisters[RTC_REGISTERS];              // Raw (BCD) copy from the last completed burst read
+
+extern void    rtcInit(uint8_t control);                 // Configure the ~INT/SQW pin and turn the 32kHz output off
+extern void    rtcSetTime(uint8_t hour, uint8_t minute, uint8_t second);
+extern void    rtcSetAlarm1(uint8_t hour, uint8_t minute);         // Daily at the hour:minute:00
+extern void    rtcSetAlarm2(uint8_t hour, uint8_t minute, uint8_t tag); // Daily at the hour:minute, the `tag` goes to the ignored date bits
+extern void    rtcWait(void);                            // Until the control and status registers are written
+extern void    rtcRefresh(void);                         // Start a burst read of all the registers
+extern uint8_t rtcReady(void);                           // The burst read finished and the rtcRegisters are fresh
+extern void    rtcGetTime(uint8_t *hour, uint8_t *minute, uint8_t *second); // Decode the rtcRegisters
+extern uint8_t rtcTimeLost(void);                        // The rtcRegisters have the OSF set, the time in them is garbage
+extern int8_t  rtcTemperature(void);                     // Whole degrees C from the rtcRegisters, rounded down
+extern uint8_t rtcFromBcd(uint8_t value);
+
+#endif
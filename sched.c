@@ -0,0 +1,151 @@
+#include <stdint.h>  // `uint8_t` and `uint16_t`
+
+#include "hal.h"     // AVR Mega88 PA (or its simulation)
+#include "sched.h"
+#include "profile.h"
+
+
+// The events are bits in a single word, posting is an OR and taking is an AND, so the
+// queue never overflows and an event posted twice before it's handled is handled once.
+// Each event has one deadline slot, the "wheel" is a fixed table walked only when the
+// Timer1 compare says the earliest deadline passed, a few slots are cheaper to walk than
+// to keep sorted.
+
+volatile uint16_t schedEvents    = 0;  // Posted and not taken yet
+volatile uint16_t schedOverflows = 0;  // Upper 16 bits of the time, counted by the Timer1 overflow IRQ
+volatile bit      schedDue       = 0;  // The Timer1 compare matched, some deadline might have passed
+bit               schedChanged   = 1;  // The deadlines changed, the Timer1 compare has to be moved
+uint16_t          schedActive    = 0;  // Slots with a deadline
+uint32_t          schedDeadlines[SCHED_SLOTS];
+
+
+// Timer1 overflow interrupt service routine, every 8.4s
+HAL_ISR(TIM1_OVF) void timer1_ovf_isr(void) {
+  schedOverflows++;
+}
+
+
+// Timer1 output compare A interrupt service routine, the nearest deadline (or the
+// SCHED_MAX_SLEEP) is here, the super loop will find out which one it was
+HAL_ISR(TIM1_COMPA) void timer1_compa_isr(void) {
+  profileBegin(PROFILE_ISR_SCHED);
+  schedDue = 1;
+  profileEnd(PROFILE_ISR_SCHED);
+}
+
+
+void schedPost(uint16_t events) {
+  uint8_t interrupts = halInterruptsSave();
+
+  halInterruptsDisable();
+  schedEvents |= events;
+  halInterruptsRestore(interrupts);
+}
+
+
+uint8_t schedTake(uint16_t events) {
+  uint16_t taken;
+
+  if (!(schedEvents & events)) return 0; // Quick check without the IRQs disabled, only the IRQs add events
+  halInterruptsDisable();
+  taken        = schedEvents & events;
+  schedEvents &= ~events;
+  halInterruptsEnable();
+  return taken ? 1 : 0;
+}
+
+
+uint32_t schedNow(void) {
+  uint8_t  interrupts = halInterruptsSave();
+  uint16_t low, high;
+
+  halInterruptsDisable();
+  low  = TCNT1;
+  high = schedOverflows;
+  // The counter wrapped but the overflow IRQ didn't run yet (it can't, the IRQs are disabled)
+  if ((TIFR1 & (1 << TOV1)) && low < 0x8000) high++;
+  halInterruptsRestore(interrupts);
+  return ((uint32_t)high << 16) | low;
+}
+
+
+// The bit of the event is the index of its slot
+uint8_t schedSlot(uint16_t event) {
+  uint8_t slot = 0;
+
+  while (event > 1) {
+    event >>= 1;
+    slot++;
+  }
+  return slot;
+}
+
+
+void schedAfter(uint16_t event, uint32_t ticks) {
+  schedDeadlines[schedSlot(event)] = schedNow() + ticks;
+  schedActive  |= event;
+  schedChanged  = 1;
+}
+
+
+void schedCancel(uint16_t event) {
+  schedActive  &= ~event;
+  schedChanged  = 1;
+  schedTake(event);
+}
+
+
+void schedRun(void) {
+  uint32_t now;
+  uint16_t event;
+  uint8_t  slot;
+
+  if (!schedDue) return;
+  schedDue     = 0;
+  schedChanged = 1;
+  now          = schedNow();
+
+  for (slot = 0, event = 1; slot < SCHED_SLOTS; slot++, event <<= 1) {
+    if (!(schedActive & event)) continue;
+    if ((int32_t)(schedDeadlines[slot] - now) > 0) continue;
+    schedActive &= ~event;
+    schedPost(event);
+  }
+}
+
+
+// Move the Timer1 compare to the nearest deadline, the time is compared with the
+// wrap-around in mind, so the 32-bit ticks can overflow after the 6 days just fine
+void schedProgram(void) {
+  uint32_t now   = schedNow();
+  uint32_t delay = SCHED_MAX_SLEEP;
+  int32_t  left;
+  uint16_t event;
+  uint8_t  slot;
+
+  for (slot = 0, event = 1; slot < SCHED_SLOTS; slot++, event <<= 1) {
+    if (!(schedActive & event)) continue;
+    left = (int32_t)(schedDeadlines[slot] - now);
+    if (left < (int32_t)delay) delay = (left < 2) ? 2 : left; // 2 ticks, so the TCNT1 can't pass the compare while it's written
+  }
+
+  halInterruptsDisable();
+  OCR1A = TCNT1 + (uint16_t)delay;
+  halFlagClear(TIFR1, OCF1A);                 // Compare matches of the previous deadline are stale
+  halInterruptsEnable();
+  schedChanged = 0;
+}
+
+
+// The only place where the super loop sleeps. The IDLE keeps the Timer0 (VFD multiplex) and the
+// Timer1 running, any IRQ wakes the CPU up. The check is done with the IRQs disabled and the HAL
+// enables them together with the sleep, an event posted or a deadline passed in between wakes it.
+void schedSleep(void) {
+  if (schedChanged) schedProgram();
+  halInterruptsDisable();
+  if (schedEvents || schedDue) {
+    halInterruptsEnable();
+    return;
+  }
+  halSleepIdle();
+}
@@ -0,0 +1,43 @@
+#ifndef SMARTWATCH_SCHED_H
+#define SMARTWATCH_SCHED_H
+
+#include <stdint.h> // `uint8_t` and `uint16_t`
+
+// Tickless cooperative scheduler. The work of the super loop is split into events, an event
+// is posted either by an IRQ (button, square wave, TWI) or by a deadline expiring. The Timer1
+// counts 128us ticks and its compare A is moved to the nearest deadline, so the CPU is woken
+// up only when there is something to do instead of by a fixed 20Hz systick.
+
+// Events, each one is a bit of the queue, the same bit selects its deadline slot
+#define SCHED_BUTTON     0x0001  // WAKE-UP button pressed or released
+#define SCHED_HOLD       0x0002  // WAKE-UP button held long enough for the next action (or the double press window closed)
+#define SCHED_SECOND     0x0004  // Square wave edge, the time and the ':' need to be redrawn
+#define SCHED_RTC        0x0008  // RTC burst read finished
+#define SCHED_ANIMATION  0x0010  // Next frame of the Neopixel animation
+#define SCHED_INACTIVE   0x0020  // Nothing pressed for a while, the 'set time' moves on
+#define SCHED_FADE_OUT   0x0040  // The sleep is near, start the power-down fade
+#define SCHED_SLEEP      0x0080  // Sleep timeout
+#define SCHED_BATTERY    0x0100  // Battery voltage measured
+#define SCHED_VFD_POWER  0x0200  // Next step of the VFD power sequence
+#define SCHED_ALARM      0x0400  // Next step of the alarm's vibration pattern
+#define SCHED_UART       0x0800  // Byte received on the command channel
+#define SCHED_MESSAGE    0x1000  // The message pushed over the UART was displayed long enough
+
+#define SCHED_SLOTS      16
+
+// Timer1 with the clk/1024 prescaler, at 8MHz one tick is 128us
+#define SCHED_PRESCALER  1024UL
+#define SCHED_MS(ms)     ((uint32_t)((HAL_F_CPU / SCHED_PRESCALER) * (ms) / 1000UL))
+#define SCHED_US(us)     ((uint32_t)(((HAL_F_CPU / SCHED_PRESCALER) * (us) + 999999UL) / 1000000UL)) // Rounded up, at least 1 tick
+#define SCHED_MAX_SLEEP  0x4000  // Re-evaluate at least every ~2s, keeps the 16-bit compare far from ambiguous
+
+
+extern void    schedPost(uint16_t events);                   // Safe to call from the IRQs as well
+extern uint8_t schedTake(uint16_t events);                   // Returns 1 and removes the events if any of them was posted
+extern void    schedAfter(uint16_t event, uint32_t ticks);   // Post the event after the ticks (replaces its previous deadline)
+extern void    schedCancel(uint16_t event);                  // Forget the deadline (and the event if it was already posted)
+extern uint32_t schedNow(void);                              // Ticks since the start, frozen in the power-down
+extern void    schedRun(void);                               // Post the events of the expired deadlines
+extern void    schedSleep(void);                             // Idle until the next deadline or IRQ
+
+#endif
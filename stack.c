@@ -0,0 +1,41 @@
+#include <stdint.h>  // `uint8_t` and `uint16_t`
+
+#include "hal.h"     // AVR Mega88 PA (or its simulation)
+#include "stack.h"
+
+
+#if HAL_DATA_STACK_SIZE > 255 || HAL_HW_STACK_SIZE > 255 || STACK_DATA_MARGIN >= HAL_DATA_STACK_SIZE
+#error "The stacks are measured with 8-bit counters and the margin has to leave something to paint"
+#endif
+
+
+// Untouched bytes from the `bottom` up, the stacks grow down towards it
+static uint8_t stackUnused(uint8_t *bottom, uint8_t size) {
+  uint8_t i;
+
+  for (i = 0; i < size && STACK_PAINT == bottom[i]; i++);
+  return i;
+}
+
+
+void stackPaint(void) {
+  uint8_t *data = halDataStack();
+  uint8_t *hw   = halHwStack();
+  uint8_t *sp   = halHwStackPointer();         // Points to the next free byte
+
+  while (data < halDataStack() + HAL_DATA_STACK_SIZE - STACK_DATA_MARGIN) *data++ = STACK_PAINT;
+
+  // The stackPaint's own return address is above the SP, the call to the stackUnused will
+  // overwrite the bytes right below the SP, which are counted as used anyway (the main() calls further)
+  while (hw <= sp) *hw++ = STACK_PAINT;
+}
+
+
+uint8_t stackDataUsed(void) {
+  return HAL_DATA_STACK_SIZE - stackUnused(halDataStack(), HAL_DATA_STACK_SIZE);
+}
+
+
+uint8_t stackHwUsed(void) {
+  return HAL_HW_STACK_SIZE - stackUnused(halHwStack(), HAL_HW_STACK_SIZE);
+}
@@ -0,0 +1,30 @@
+#ifndef SMARTWATCH_STACK_H
+#define SMARTWATCH_STACK_H
+
+#include <stdint.h> // `uint8_t` and `uint16_t`
+
+// High-water marks of the two CodeVisionAVR stacks:
+//
+// - the data stack (the Y register), the first HAL_DATA_STACK_SIZE bytes of the RAM, holds the
+//   arguments, the local variables and the registers saved by the ISRs, it grows down towards
+//   the start of the RAM and the globals are right above it
+// - the hardware stack (the SP), grows down from the RAMEND towards the globals, it holds only
+//   the return addresses (2 bytes per call or IRQ), so only its top HAL_HW_STACK_SIZE bytes are watched
+//
+// The free parts of both are painted with the STACK_PAINT at the start of the main(), anything
+// which touched a byte since then overwrote the paint (a byte written with the same value is
+// missed, 1 in 256). The scans walk from the far end until the first overwritten byte, so the
+// result is the deepest point reached so far, no matter which IRQ nested on top of what.
+//
+// In the simulator the stacks are the host's and the painted regions are stand-ins which nobody
+// writes, the simulator measures the depth of its own stack instead (see host/hal_host.h).
+
+#define STACK_PAINT         0xA5
+#define STACK_DATA_MARGIN   8     // Top of the data stack in use by the main() when it's painted
+
+
+extern void     stackPaint(void);        // The first thing in the main(), before the IRQs are enabled
+extern uint8_t  stackDataUsed(void);     // Deepest use of the data stack since the stackPaint, in bytes
+extern uint8_t  stackHwUsed(void);       // Same for the hardware stack
+
+#endif
@@ -0,0 +1,121 @@
+#include <stdint.h>  // `uint8_t` and `uint16_t`
+
+#include "hal.h"     // AVR Mega88 PA (or its simulation)
+#include "main.h"
+#include "vfd.h"
+#include "store.h"
+
+
+#if STORE_SLOTS & (STORE_SLOTS - 1)
+#error "The STORE_SLOTS must be a power of 2"
+#endif
+
+
+storeRecord      storeState;
+storeRecord      storeSaved;                         // The newest record in the EEPROM, the IRQ writes it from here
+uint8_t          storeSlot  = STORE_SLOTS - 1;       // Slot of the newest record, the first flush goes to the slot 0
+volatile uint8_t storeIndex = STORE_RECORD_SIZE;     // Next byte of the storeSaved the IRQ writes
+
+
+// CRC-8 (Dallas/Maxim polynomial) starting from 0xFF, neither an erased nor a zeroed slot passes it
+uint8_t storeCrc(uint8_t *data, uint8_t length) {
+  uint8_t crc = 0xFF;
+  uint8_t i;
+
+  while (length--) {
+    crc ^= *data++;
+    for (i = 0; i < 8; i++) crc = (crc & 1) ? (crc >> 1) ^ 0x8C : crc >> 1;
+  }
+  return crc;
+}
+
+
+uint8_t storeRead(uint16_t address) {
+  while (EECR & (1 << EEPE));                        // Can't read while a write is in progress
+  EEAR = address;
+  halEepromRead();
+  return EEDR;
+}
+
+
+void storeInit(void) {
+  storeRecord record;
+  uint8_t    *bytes = (uint8_t *)&record;
+  uint8_t     found = 0;
+  uint8_t     slot, i;
+
+  for (slot = 0; slot < STORE_SLOTS; slot++) {
+    for (i = 0; i < STORE_RECORD_SIZE; i++) bytes[i] = storeRead(slot * STORE_RECORD_SIZE + i);
+    if (record.crc != storeCrc(bytes, STORE_RECORD_SIZE - 1)) continue;   // Erased or torn
+    if (found && (int16_t)(record.sequence - storeSaved.sequence) <= 0) continue;
+    storeSaved = record;
+    storeSlot  = slot;
+    found      = 1;
+  }
+
+  if (found) {
+    storeState = storeSaved;
+  } else {
+    // Nothing was ever flushed (or the whole log is corrupted), the storeSaved stays zeroed so the first flush differs
+    storeState.brightness = VFD_BRIGHTNESS_DEFAULT;
+    storeState.timeout    = SLEEP_TIMEOUT_MS / 1000;
+    storeState.hour       = 8;                       // On power up start with 8:00 time
+    storeState.minute     = 0;
+  }
+  storeState.resets++;
+}
+
+
+// EEPROM ready interrupt service routine, requested whenever no write is in progress
+// and the EERIE is set. Writes the next byte which differs from what the slot has.
+HAL_ISR(EE_RDY) void ee_rdy_isr(void) {
+  uint8_t data;
+
+  while (storeIndex < STORE_RECORD_SIZE) {
+    data  = ((uint8_t *)&storeSaved)[storeIndex];
+    EEAR  = storeSlot * STORE_RECORD_SIZE + storeIndex++;
+    halEepromRead();
+    if (EEDR == data) continue;                      // No wear and no 3.4ms for the same value
+    EEDR = data;
+    halEepromWrite();
+    return;
+  }
+  EECR &= ~(1 << EERIE);                             // The whole record is written
+}
+
+
+void storeFlush(void) {
+  uint8_t *state = (uint8_t *)&storeState;
+  uint8_t *saved = (uint8_t *)&storeSaved;
+  uint8_t  i;
+
+  storeWait();                                       // The IRQ is still writing the storeSaved
+  for (i = 2; i < STORE_RECORD_SIZE - 1; i++) {      // Everything between the sequence and the CRC
+    if (state[i] != saved[i]) break;
+  }
+  if (i == STORE_RECORD_SIZE - 1) return;            // Nothing changed since the newest record
+
+  storeState.sequence = storeSaved.sequence + 1;
+  storeState.crc      = storeCrc(state, STORE_RECORD_SIZE - 1);
+  storeSaved          = storeState;
+  storeSlot           = (storeSlot + 1) & (STORE_SLOTS - 1);
+  storeIndex          = 0;
+  EECR               |= (1 << EERIE);                // No write is in progress, so the IRQ comes right away
+}
+
+
+uint8_t storeBusy(void) {
+  return EECR & (1 << EERIE);
+}
+
+
+// Checked with the IRQs disabled and slept with the halSleepIdle, an EE_READY IRQ finishing the
+// record in between wakes the CPU instead of the next unrelated IRQ (the VFD is off by then)
+void storeWait(void) {
+  halInterruptsDisable();
+  while (storeBusy()) {
+    halSleepIdle();
+    halInterruptsDisable();
+  }
+  halInterruptsEnable();
+}
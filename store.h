@@ -0,0 +1,42 @@
+#ifndef SMARTWATCH_STORE_H
+#define SMARTWATCH_STORE_H
+
+#include <stdint.h> // `uint8_t` and `uint16_t`
+
+// Settings and usage counters kept in the EEPROM. The EEPROM is a ring of fixed size records,
+// each flush appends a whole record into the slot after the newest one, so every cell is
+// written only once per STORE_SLOTS flushes. At the reset the newest record with a valid CRC
+// wins, a record torn by a reset in the middle of its write is simply skipped.
+//
+// The running counters live in the storeState and are flushed once per sleep cycle (before
+// the power-down), the bytes are written from the EEPROM ready IRQ so nothing waits 3.4ms
+// per byte, and bytes which already have the right value in the slot are not written at all.
+
+#define STORE_RECORD_SIZE  16
+#define STORE_SLOTS        (512 / STORE_RECORD_SIZE)
+
+
+// Ordered so that no member needs padding, the record is written and read byte by byte
+typedef struct {
+  uint16_t sequence;      // Newer records have a higher number (with a wrap-around)
+  uint16_t wakes;         // How many times the button woke the watch up
+  uint16_t setTimes;      // How many times the time was set
+  uint8_t  brightness;    // vfdBrightness, the user's VFD brightness level
+  uint8_t  timeout;       // Seconds without a press before going to sleep
+  uint32_t awakeSeconds;  // Time spent with the VFD on
+  uint8_t  hour;          // Last known time, used when the RTC lost it (see the clockStart)
+  uint8_t  minute;
+  uint8_t  resets;        // How many times the MCU started from scratch
+  uint8_t  crc;           // CRC-8 of all the bytes above
+} storeRecord;
+
+
+extern storeRecord storeState;    // Current values, change them freely, the storeFlush decides what to write
+
+
+extern void    storeInit(void);   // Find the newest record (or the defaults) and count the reset
+extern void    storeFlush(void);  // Append the storeState to the ring if it changed, returns right away
+extern uint8_t storeBusy(void);   // A flush is still being written
+extern void    storeWait(void);   // Sleep until the flush is written, needed before the power-down
+
+#endif
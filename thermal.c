@@ -0,0 +1,31 @@
+#include <stdint.h>  // `uint8_t` and `uint16_t`
+
+#include "hal.h"     // AVR Mega88 PA (or its simulation)
+#include "vfd.h"
+#include "thermal.h"
+
+
+#if VFD_LEVEL_5 * THERMAL_TRIM_MAX / 16 >= VFD_SLOT_TICKS
+#error "The brightest level stretched by the THERMAL_TRIM_MAX has to be shorter than the VFD_SLOT_TICKS"
+#endif
+
+
+int8_t thermalCelsius = THERMAL_UNKNOWN;
+
+flash thermalPoint thermalCurve[THERMAL_POINTS] = {
+  {   32, 14, 4 },   // Warm room and a warm wrist
+  {   26, 15, 4 },
+  {   18, 16, VFD_FILAMENT_DUTY }, // Room temperature, where the levels were tuned
+  {    8, 18, 6 },
+  {    0, 20, 7 },
+  { -128, THERMAL_TRIM_MAX, VFD_FILAMENT_STEPS },  // Freezing, the filament with the full DC power
+};
+
+
+void thermalApply(int8_t celsius) {
+  uint8_t i = 0;
+
+  thermalCelsius = celsius;
+  while (i < THERMAL_POINTS - 1 && celsius < thermalCurve[i].celsius) i++;
+  vfdCompensate(thermalCurve[i].trim, thermalCurve[i].duty);
+}
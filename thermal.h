@@ -0,0 +1,31 @@
+#ifndef SMARTWATCH_THERMAL_H
+#define SMARTWATCH_THERMAL_H
+
+#include <stdint.h> // `uint8_t` and `uint16_t`
+
+// Temperature compensation of the VFD's drive. The DS3231M measures its temperature for its own
+// oscillator anyway and the burst read after each wake-up includes it, so it costs nothing extra.
+// A cold filament emits fewer electrons, the segments look dimmer with the same on-time, and a
+// warm one emits more. So instead of sizing the filament and the on-times for a cold wrist
+// outdoors, they follow a calibration curve, once per wake-up (the VFD doesn't change while on).
+//
+// The curve's row with the room temperature has the trim 16/16 and the VFD_FILAMENT_DUTY, the
+// levels in the vfd.h were tuned there. Between the rows the drive doesn't change, a step per
+// ~8C is below what the eye notices from one glance to the next.
+
+#define THERMAL_POINTS     6
+#define THERMAL_TRIM_MAX   22    // 1/16ths, the brightest level stretched by it has to leave a blank part of the slot
+#define THERMAL_UNKNOWN    -128  // thermalCelsius before the first burst read
+
+typedef struct {
+  int8_t  celsius;               // Lowest temperature of the row, the rows go from the warmest
+  uint8_t trim;                  // On-times in 1/16ths of the vfdLevels
+  uint8_t duty;                  // Filament's maintenance duty in the VFD_FILAMENT_STEPS
+} thermalPoint;
+
+
+extern int8_t thermalCelsius;            // The last temperature applied
+
+extern void   thermalApply(int8_t celsius);  // Look up the curve and hand it to the vfdCompensate
+
+#endif
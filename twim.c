@@ -0,0 +1,164 @@
+#include <stdint.h>  // `uint8_t` and `uint16_t`
+
+#include "hal.h"     // AVR Mega88 PA (or its simulation)
+#include "twim.h"
+#include "sched.h"
+#include "power.h"
+#include "profile.h"
+
+
+// TWI status codes (TWSR with the prescaler bits masked)
+#define TWIM_START          0x08
+#define TWIM_REPEATED_START 0x10
+#define TWIM_SLA_W_ACK      0x18
+#define TWIM_DATA_W_ACK     0x28
+#define TWIM_ARBITRATION    0x38
+#define TWIM_SLA_R_ACK      0x40
+#define TWIM_DATA_R_ACK     0x50
+#define TWIM_DATA_R_NACK    0x58
+
+// TWCR values, the TWINT is cleared by writing 1 and that starts the next bus action
+#define TWIM_CONTINUE       ((1 << TWINT) | (1 << TWEN) | (1 << TWIE))
+#define TWIM_ACK            (TWIM_CONTINUE | (1 << TWEA))
+#define TWIM_SEND_START     (TWIM_CONTINUE | (1 << TWSTA))
+#define TWIM_SEND_STOP      (TWIM_CONTINUE | (1 << TWSTO))
+#define TWIM_STOP_START     (TWIM_SEND_STOP | (1 << TWSTA))  // The stop is followed by a start as soon as possible
+
+// SCL = F_CPU / (16 + 2 * TWBR) with the prescaler 1, 2 at 8MHz and 400kHz
+#define TWIM_TWBR           ((HAL_F_CPU / 1000UL / TWIM_BITRATE_KHZ - 16) / 2)
+
+#if (HAL_F_CPU / 1000UL / TWIM_BITRATE_KHZ < 16) || (TWIM_TWBR > 255)
+#error "The TWIM_BITRATE_KHZ can't be reached with this CPU clock and the TWI prescaler 1"
+#endif
+
+
+twimTransfer         *twimQueue[TWIM_QUEUE];
+volatile uint8_t      twimHead   = 0;   // The transfer on the bus (or the next one to start)
+volatile uint8_t      twimTail   = 0;   // Where the next submitted transfer goes
+uint8_t               twimIndex  = 0;   // Next byte of the data to be written or read
+
+
+void twimInit(void) {
+  TWBR = TWIM_TWBR;
+  TWSR = (0 << TWPS1) | (0 << TWPS0);
+  halTwiControl((1 << TWEN));
+}
+
+
+uint8_t twimIdle(void) {
+  return twimHead == twimTail;
+}
+
+
+uint8_t twimFull(void) {
+  return ((twimTail + 1) & (TWIM_QUEUE - 1)) == twimHead;
+}
+
+
+uint8_t twimSubmit(twimTransfer *transfer) {
+  uint8_t wasIdle;
+
+  if (twimFull()) return 0;
+
+  transfer->status = TWIM_QUEUED;
+  halInterruptsDisable();
+  wasIdle = twimIdle();
+  twimQueue[twimTail] = transfer;
+  twimTail = (twimTail + 1) & (TWIM_QUEUE - 1);
+  if (wasIdle) {
+    // The bus is free, kick off the start condition, the IRQ continues from there. The TWI
+    // was gated meanwhile and needs to be initialized again after it gets its clock back.
+    powerAcquire(POWER_TWI);
+    twimInit();
+    twimIndex = 0;
+    halTwiControl(TWIM_SEND_START);
+  }
+  halInterruptsEnable();
+  return 1;
+}
+
+
+// The status is checked with the IRQs disabled and the halSleepIdle enables them together with the
+// SLEEP, a transfer finished in between wakes the CPU instead of the next unrelated IRQ
+void twimWait(twimTransfer *transfer) {
+  halInterruptsDisable();
+  while ((TWIM_QUEUED == transfer->status) || (TWIM_BUSY == transfer->status)) {
+    halSleepIdle();
+    halInterruptsDisable();
+  }
+  halInterruptsEnable();
+}
+
+
+// The current transfer is finished, release the bus and start the next queued transfer (if any)
+void twimFinish(uint8_t status) {
+  twimQueue[twimHead]->status = status;
+  if (twimQueue[twimHead]->event) schedPost(twimQueue[twimHead]->event);
+  twimHead  = (twimHead + 1) & (TWIM_QUEUE - 1);
+  twimIndex = 0;
+  if (!twimIdle()) {
+    halTwiControl(TWIM_STOP_START);
+    return;
+  }
+
+  // Nothing else queued, gate the TWI once the stop condition is on the bus (~1us at 400kHz)
+  halTwiControl(TWIM_SEND_STOP);
+  while (TWCR & (1 << TWSTO));
+  powerRelease(POWER_TWI);
+}
+
+
+// 2-wire Serial Interface interrupt service routine, one bus event at a time
+HAL_ISR(TWI) void twi_isr(void) {
+  twimTransfer *transfer = twimQueue[twimHead];
+
+  profileBegin(PROFILE_ISR_TWI);
+  switch (TWSR & 0xF8) {
+    case TWIM_START:
+    case TWIM_REPEATED_START:
+      transfer->status = TWIM_BUSY;
+      // Address the slave for writing first, the repeated start after the written bytes switches to reading
+      TWDR = (transfer->address << 1) | ((twimIndex < transfer->writeLength) ? 0 : 1);
+      halTwiControl(TWIM_CONTINUE);
+    break;
+
+    case TWIM_SLA_W_ACK:
+    case TWIM_DATA_W_ACK:
+      if (twimIndex < transfer->writeLength) {
+        TWDR = transfer->data[twimIndex++];
+        halTwiControl(TWIM_CONTINUE);
+      } else if (transfer->readLength) {
+        halTwiControl(TWIM_SEND_START);
+      } else {
+        twimFinish(TWIM_DONE);
+      }
+    break;
+
+    case TWIM_SLA_R_ACK:
+      // Acknowledge all the bytes except the last one, that tells the slave the read is over
+      halTwiControl((transfer->readLength > 1) ? TWIM_ACK : TWIM_CONTINUE);
+    break;
+
+    case TWIM_DATA_R_ACK:
+      transfer->data[twimIndex++] = TWDR;
+      halTwiControl((twimIndex < transfer->writeLength + transfer->readLength - 1) ? TWIM_ACK : TWIM_CONTINUE);
+    break;
+
+    case TWIM_DATA_R_NACK:
+      transfer->data[twimIndex++] = TWDR;
+      twimFinish(TWIM_DONE);
+    break;
+
+    case TWIM_ARBITRATION:
+      // Some other master took the bus, try again from the beginning when the bus is free
+      twimIndex = 0;
+      halTwiControl(TWIM_SEND_START);
+    break;
+
+    default:
+      // NACK of the address or the data, or a bus error
+      twimFinish(TWIM_ERROR);
+    break;
+  }
+  profileEnd(PROFILE_ISR_TWI);
+}
@@ -0,0 +1,38 @@
+#ifndef SMARTWATCH_TWIM_H
+#define SMARTWATCH_TWIM_H
+
+#include <stdint.h> // `uint8_t` and `uint16_t`
+
+// Interrupt driven TWI(I2C) master, the transfers are queued and progress byte by byte
+// from the TWI IRQ, so the super loop never waits on the bus
+
+#define TWIM_BITRATE_KHZ 400 // Fast-mode, the DS3231M supports up to 400kHz
+#define TWIM_QUEUE       4   // How many transfers can wait for the bus, must be a power of 2
+
+// Transfer status, everything from TWIM_DONE upwards means the transfer left the queue
+#define TWIM_IDLE        0   // Never submitted
+#define TWIM_QUEUED      1   // Waiting for the bus
+#define TWIM_BUSY        2   // On the bus right now
+#define TWIM_DONE        3   // Finished, the read bytes are valid
+#define TWIM_ERROR       4   // Slave didn't acknowledge or the bus failed, the transfer was abandoned
+
+
+// A write of `writeLength` bytes followed by a repeated start and a read of `readLength` bytes,
+// the read bytes are stored in the `data` right after the written ones. Either length can be 0.
+typedef struct {
+  uint8_t          address;     // 7-bit slave address
+  uint8_t          writeLength;
+  uint8_t          readLength;
+  uint8_t         *data;
+  volatile uint8_t status;      // TWIM_IDLE..TWIM_ERROR, updated by the IRQ
+  uint16_t         event;       // Scheduler event posted when the transfer leaves the queue, 0 for none
+} twimTransfer;
+
+
+extern void    twimInit(void);                      // Set the bit rate and enable the TWI module
+extern uint8_t twimSubmit(twimTransfer *transfer);  // Queue the transfer, returns 0 when the queue is full
+extern uint8_t twimIdle(void);                      // Nothing on the bus and nothing queued
+extern uint8_t twimFull(void);                      // No room in the queue until the transfer on the bus finishes
+extern void    twimWait(twimTransfer *transfer);    // Sleep until the transfer leaves the queue (if it is queued at all)
+
+#endif
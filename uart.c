@@ -0,0 +1,185 @@
+#include <stdint.h>  // `uint8_t` and `uint16_t`
+
+#include "hal.h"     // AVR Mega88 PA (or its simulation)
+#include "pins.h"
+#include "sched.h"
+#include "power.h"
+#include "uart.h"
+
+
+#if (UART_RX_SIZE & (UART_RX_SIZE - 1)) || (UART_TX_SIZE & (UART_TX_SIZE - 1)) || UART_RX_SIZE > 128 || UART_TX_SIZE > 128
+#error "The UART rings have to be a power of 2 and fit the free running 8-bit indexes"
+#endif
+
+#if UART_PAYLOAD_MAX + UART_OVERHEAD > UART_RX_SIZE
+#error "The longest frame has to fit into the RX ring, it's parsed in place"
+#endif
+
+
+// The indexes run freely and wrap at 256, the ring's size divides it, so `head - tail`
+// is the number of bytes in the ring even after the wrap. Only the IRQ writes the
+// uartRxHead and the uartTxTail, only the super loop the uartRxTail and the uartTxHead.
+uint8_t          uartRxRing[UART_RX_SIZE];
+uint8_t          uartTxRing[UART_TX_SIZE];
+volatile uint8_t uartRxHead   = 0;
+uint8_t          uartRxTail   = 0;
+uint8_t          uartTxHead   = 0;
+volatile uint8_t uartTxTail   = 0;
+volatile uint8_t uartOverruns = 0;
+volatile bit     uartTxSent   = 0;  // A byte went to the UDR0 since the last drain, its TXC0 is to be waited for
+
+
+// USART0 RX complete interrupt service routine, the status has to be read before the data
+HAL_ISR(USART_RXC) void usart_rx_isr(void) {
+  uint8_t status = UCSR0A;
+  uint8_t data   = UDR0;
+
+  if (status & ((1 << FE0) | (1 << DOR0))) return;   // Broken byte, the checksum would drop its frame anyway
+  if ((uint8_t)(uartRxHead - uartRxTail) >= UART_RX_SIZE) {
+    uartOverruns++;
+    return;
+  }
+  uartRxRing[uartRxHead & (UART_RX_SIZE - 1)] = data;
+  uartRxHead++;                                        // Published only after the byte is in the ring
+  schedPost(SCHED_UART);
+}
+
+
+// USART0 data register empty interrupt service routine, requested for as long as the UDRIE0 is set.
+// The TXC0 is cleared with each byte, so it's set only once the last one is shifted out.
+HAL_ISR(USART_DRE) void usart_dre_isr(void) {
+  if (uartTxTail == uartTxHead) {
+    UCSR0B &= ~(1 << UDRIE0);                          // Nothing more to send
+    return;
+  }
+  halFlagClear(UCSR0A, TXC0);
+  halUartWrite(uartTxRing[uartTxTail & (UART_TX_SIZE - 1)]);
+  uartTxTail++;
+  uartTxSent = 1;
+}
+
+
+// Baud rate, frame format, the receiver and the transmitter. Done again on each wake-up, the USART0
+// should be re-initialized after its clock was gated.
+static void uartSetup(void) {
+  UBRR0H = UART_UBRR >> 8;
+  UBRR0L = UART_UBRR & 0xFF;
+  UCSR0A = (0<<U2X0) | (0<<MPCM0);
+  UCSR0C = (0<<UMSEL01) | (0<<UMSEL00) | (0<<UPM01) | (0<<UPM00) | (0<<USBS0) | (1<<UCSZ01) | (1<<UCSZ00) | (0<<UCPOL0);
+  UCSR0B = (1<<RXCIE0) | (0<<TXCIE0) | (0<<UDRIE0) | (1<<RXEN0) | (1<<TXEN0) | (0<<UCSZ02) | (0<<RXB80) | (0<<TXB80);
+}
+
+
+// The watch starts awake, the USART is clocked until the first uartSleep
+void uartInit(void) {
+  powerAcquire(POWER_USART0);
+  uartSetup();
+}
+
+
+uint8_t uartAvailable(void) {
+  return uartRxHead - uartRxTail;
+}
+
+
+uint8_t uartPeek(uint8_t offset) {
+  return uartRxRing[(uint8_t)(uartRxTail + offset) & (UART_RX_SIZE - 1)];
+}
+
+
+void uartDrop(uint8_t count) {
+  uartRxTail += count;
+}
+
+
+// Skip everything which can't be a start of a frame, stop at a whole frame or when more bytes are needed
+uint8_t uartFrame(void) {
+  uint8_t length, sum, i;
+
+  while (uartAvailable()) {
+    if (UART_SYNC != uartPeek(0)) {
+      uartDrop(1);
+      continue;
+    }
+    if (uartAvailable() < 2) return 0;
+    length = uartPeek(1);
+    if (length > UART_PAYLOAD_MAX) {
+      uartDrop(1);                                     // Not a frame, just a byte which looked like the UART_SYNC
+      continue;
+    }
+    if (uartAvailable() < length + UART_OVERHEAD) return 0;
+
+    sum = 0;
+    for (i = 1; i < length + UART_OVERHEAD; i++) sum += uartPeek(i);
+    if (sum || !uartPeek(2)) {
+      uartDrop(1);
+      continue;
+    }
+    return uartPeek(2);
+  }
+  return 0;
+}
+
+
+uint8_t uartFramePayload(uint8_t index) {
+  return uartPeek(3 + index);
+}
+
+
+uint8_t uartFrameLength(void) {
+  return uartPeek(1);
+}
+
+
+void uartFrameDone(void) {
+  uartDrop(uartPeek(1) + UART_OVERHEAD);
+}
+
+
+void uartTxPut(uint8_t data) {
+  uartTxRing[uartTxHead & (UART_TX_SIZE - 1)] = data;
+  uartTxHead++;
+}
+
+
+// The whole frame or nothing, a half frame would only make the host resynchronize
+void uartReply(uint8_t command, uint8_t *payload, uint8_t length) {
+  uint8_t sum = length + command;
+  uint8_t i;
+
+  if ((uint8_t)(UART_TX_SIZE - (uint8_t)(uartTxHead - uartTxTail)) < length + UART_OVERHEAD) return;
+  uartTxPut(UART_SYNC);
+  uartTxPut(length);
+  uartTxPut(command);
+  for (i = 0; i < length; i++) {
+    uartTxPut(payload[i]);
+    sum += payload[i];
+  }
+  uartTxPut(-sum);
+  halInterruptsDisable();                              // The DRE IRQ clears the UDRIE0 in the same register
+  UCSR0B |= (1 << UDRIE0);
+  halInterruptsEnable();
+}
+
+
+// The queued answers go out before the power-down stops the USART's clock. At most a ring of bytes
+// (8ms), but the watch stays awake for seconds after the last command anyway, so normally nothing is
+// left to wait for. Polled, not slept, the TXC0 needs no IRQ and nothing can leave it waiting.
+void uartSleep(void) {
+  while (UCSR0B & (1 << UDRIE0)) delay_us(1);          // The DRE IRQ moves the rest of the ring to the UDR0
+  if (uartTxSent) {
+    while (!(UCSR0A & (1 << TXC0))) delay_us(1);       // The last byte leaves the shift register
+    uartTxSent = 0;
+  }
+  UCSR0B  = 0;                                         // No IRQ of the USART is enabled after the drain
+  powerRelease(POWER_USART0);
+  PCMSK2 |= pinMask(PIN_UART_RXD);
+}
+
+
+void uartWake(void) {
+  PCMSK2     &= ~pinMask(PIN_UART_RXD);
+  powerAcquire(POWER_USART0);
+  uartSetup();
+  uartRxTail  = uartRxHead;                            // The rest of the byte which woke us up is garbage
+}
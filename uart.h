@@ -0,0 +1,60 @@
+#ifndef SMARTWATCH_UART_H
+#define SMARTWATCH_UART_H
+
+#include <stdint.h> // `uint8_t` and `uint16_t`
+
+// Command channel on the USART0, 38400 8N1. The IRQs only move bytes between the data register
+// and two ring buffers, each ring has a single producer and a single consumer (the IRQ or the
+// super loop), so neither side needs to disable the IRQs, each index is written by one side only.
+// Only the UDRIE0 is shared, the super loop sets it with the IRQs disabled, the DRE IRQ clears it.
+//
+// A frame is:
+//
+//   UART_SYNC, length, command, payload[length], check
+//
+// where the `check` makes the 8-bit sum of the length, command, payload and check 0. The frames
+// are parsed in place in the RX ring (uartPeek), nothing is copied out, and a frame which doesn't
+// add up is skipped byte by byte until the next UART_SYNC. Every command is answered with a frame
+// with the same command (or UART_NAK), so the host knows it arrived.
+//
+// The TXD0 is the PD1, which the schematic uses for the VFD's DC2DC enable. The USART would switch the
+// DC2DC off for every 0 bit, so the enable is wired to the PD4 instead (see the pins.h) and the PD1
+// is the TXD0 only, the transmitter is on whenever the receiver is.
+//
+// While sleeping the USART has no clock (released to the power.c), the RXD's falling edge (a pin change IRQ) wakes the
+// watch up, but the byte which woke it is lost. The host repeats a frame which was not answered.
+
+#define UART_BAUD          38400
+#define UART_UBRR          ((HAL_F_CPU / 16 + UART_BAUD / 2) / UART_BAUD - 1)   // 12 at 8MHz, 0.2% off
+#define UART_RX_SIZE       32    // Power of 2, the longest frame has to fit
+#define UART_TX_SIZE       32    // Power of 2
+#define UART_SYNC          0xA5
+#define UART_PAYLOAD_MAX   24
+#define UART_OVERHEAD      4     // Sync, length, command and check
+
+// Commands, the payloads are little-endian
+#define UART_TIME          'T'   // hour, minute, second -> set the RTC
+#define UART_BRIGHTNESS    'B'   // level -> the user's VFD brightness
+#define UART_MESSAGE       'M'   // 1-VFD_TEXT_CHARS characters -> displayed for a while instead of the time
+#define UART_COUNTERS      'C'   // -> wakes(2), setTimes(2), awakeSeconds(4), resets, batteryMillivolts(2)
+#define UART_STACK         'S'   // -> data stack used, its size, hardware stack used, its watched size (see stack.h)
+#define UART_PROFILE       'P'   // region -> its profileRegion (22 bytes), nothing -> clear all (PROFILE builds only)
+#define UART_NAK           '?'   // Answer with the refused command as its payload
+
+
+extern volatile uint8_t uartOverruns;          // Bytes dropped because the RX ring was full
+
+
+extern void    uartInit(void);                 // Baud rate, frame format, the receiver and the transmitter
+extern uint8_t uartAvailable(void);            // Bytes received and not dropped yet
+extern uint8_t uartPeek(uint8_t offset);       // Byte in the RX ring, without removing it
+extern void    uartDrop(uint8_t count);        // Remove the bytes from the RX ring
+extern uint8_t uartFrame(void);                // A whole valid frame is at the start of the RX ring, returns its command (0 = none yet)
+extern uint8_t uartFramePayload(uint8_t index); // Byte of the payload of the frame found by the uartFrame
+extern uint8_t uartFrameLength(void);
+extern void    uartFrameDone(void);            // Drop the frame found by the uartFrame
+extern void    uartReply(uint8_t command, uint8_t *payload, uint8_t length); // Queue an answer, dropped when the TX ring is full
+extern void    uartSleep(void);                // Finish the queued bytes, gate the USART, wake up on the RXD's falling edge
+extern void    uartWake(void);                 // Clock and set up the USART again, stop listening to the RXD's edges, drop the broken bytes
+
+#endif
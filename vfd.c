@@ -1,161 +1,402 @@
-#include <mega88a.h> // AVR Mega88 PA
-#include <delay.h>   // Delay for-loop functions
-#include <spi.h>     // SPI functions to talk with MAX6920SAWP -> VFD
 #include <stdint.h>  // `uint8_t` and `uint16_t` 
 
+#include "hal.h"     // AVR Mega88 PA and delay functions (or their simulation)
+#include "pins.h"
 #include "vfd.h"
+#include "font.h"
 #include "main.h"
+#include "sched.h"
+#include "power.h"
+#include "profile.h"
 
 
-volatile uint8_t stayAwake = SLEEP_TIMEOUT; // How long before going to sleep (20Hz counter counting to 0)
-
 uint8_t vfdHour   = 255; // Init with display off
 uint8_t vfdMinute = 255;
+uint8_t vfdColon  = 0;   // 1 = display the ':' dots
+
+volatile vfdWord  vfdFrame[VFD_GRIDS];      // Frame buffer, the whole content of the display, read by the Timer0 IRQs
+vfdWord           vfdFrameOld[VFD_GRIDS];   // What each character showed before its last change, faded out by the IRQs
+volatile uint8_t  vfdFade[VFD_GRIDS];       // Until the first change it fades from blank to blank
+vfdGridMask       vfdBlink         = 0;     // VFD_BLINK_* characters which are blanked while the vfdBlinkOff
+bit               vfdBlinkOff      = 0;
+uint8_t           vfdSchedule[VFD_GRIDS];   // On-time of each character, read by the Timer0 IRQs
+uint8_t           vfdBrightness = VFD_BRIGHTNESS_DEFAULT;
+uint8_t           vfdLimit      = VFD_BRIGHTNESS_LEVELS - 1;  // Lowered by the battery policy
+uint8_t           vfdLevel      = 255;      // Level the vfdSchedule was calculated for
+uint8_t           vfdTrim       = 16;       // Temperature compensation of the on-times in 1/16ths
+uint8_t           vfdFilamentDuty  = VFD_FILAMENT_DUTY;
+uint8_t           vfdFilamentOn    = VFD_FILAMENT_STEPS;  // Duty used right now, full during the preheat
+uint8_t           vfdFilamentPhase = 0;                   // Slot within the filament's period
+uint8_t           vfdPower         = VFD_POWER_OFF;
+uint32_t          vfdPowerAt;                             // When the vfdOn started the sequence
+bit               vfdWaiting       = 0;                   // No frame with the time since the vfdOn
+uint16_t          vfdWakeLatency    = 0;
+uint16_t          vfdWakeLatencyMax = 0;
+
+flash uint8_t vfdLevels[VFD_BRIGHTNESS_LEVELS] = {
+  VFD_LEVEL_0, VFD_LEVEL_1, VFD_LEVEL_2, VFD_LEVEL_3, VFD_LEVEL_4, VFD_LEVEL_5
+};
+
+// The grids of the display.h in the refresh order: the selector of each of them (ORed into the
+// glyphs of a text), its share of the global level in 1/16ths and its character of a text
+#define DISPLAY_GRID(output, trim, text) VFD_BIT(output),
+flash vfdWord vfdGridWord[VFD_GRIDS] = { DISPLAY_GRID_LIST };
+#undef  DISPLAY_GRID
+
+#define DISPLAY_GRID(output, trim, text) trim,
+flash uint8_t vfdGridTrim[VFD_GRIDS] = { DISPLAY_GRID_LIST };
+#undef  DISPLAY_GRID
+
+#define DISPLAY_GRID(output, trim, text) text,
+flash uint8_t vfdGridText[VFD_GRIDS] = { DISPLAY_GRID_LIST };
+#undef  DISPLAY_GRID
+
+// Cross-fade, which frames of a character show the new word (1) and which the old one (0). Each
+// byte is 8 frames, the new word gets 0/8 to 7/8 of them in 8 steps of 2 bytes, so the segments
+// which appear ramp up and the ones which disappear ramp down, the common ones glow all the time.
+// The 1s are spread over the byte, the eye averages 8 frames (10ms) without any flicker.
+flash uint8_t vfdFadeBits[VFD_FADE_FRAMES / 8] = {
+  0x00, 0x00, 0x01, 0x01, 0x11, 0x11, 0x25, 0x25, 0x55, 0x55, 0x5B, 0x5B, 0x77, 0x77, 0x7F, 0x7F
+};
+flash uint8_t vfdFadeMasks[8] = { 0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80 };
+
+uint8_t          vfdGrid       = 0;         // Which character (index to vfdFrame) is displayed in the current slot
+uint8_t          vfdSpiBytes[VFD_SPI_BYTES - 1]; // The lower bytes of the word which are still waiting to be shifted, the lowest first
+volatile uint8_t vfdSpiPending = 0;         // How many of the vfdSpiBytes need to be shifted before the LOAD pulse
+volatile bit     vfdSpiRelease = 0;             // The word being shifted is the last one, the SPI can be gated after it
+volatile bit     vfdSpiBusy    = 0;             // A word is being shifted, set by the vfdShift, cleared after its LOAD pulse
+uint8_t          vfdPausedClock = 0;            // The TCCR0B before the vfdPause stopped the Timer0's clock
+#if PROFILE
+bit              vfdSlotStarted = 0;            // The PROFILE_REFRESH has the start of a slot, the first slot after the vfdOff has none
+#endif
+
+
+
+// VFD's high-voltage DC2DC boost converter and low-voltage filament heater, 
+// macros and not functions as the CodeVisionAVR would not inline them
+#define dc2dcOff()  pinLow(PIN_DC2DC)
+#define dc2dcOn()   pinHigh(PIN_DC2DC)
+#define fHeatOff()  pinLow(PIN_FILAMENT)
+#define fHeatOn()   pinHigh(PIN_FILAMENT)
+
+
+// Start shifting a word to the driver, the VFD_SPI_BYTES whole bytes of it, the bits above the
+// DISPLAY_DRIVER_BITS fall out of the driver's shift register (bit 12-15 of the MAX6920AWP).
+// Only the high byte is written here, the lower bytes and the LOAD pulse are done by the SPI IRQ.
+// The Timer0 IRQs call it a slot or an on-time after the previous word, long shifted out by then.
+// With the Timer0 stopped the caller has to wait for the vfdSpiBusy to clear first, a word started
+// by the last IRQ might still be in the SPI.
+void vfdShift(vfdWord data) {
+  vfdSpiBusy     = 1;
+  vfdSpiBytes[0] = data & 0xff;
+#if VFD_SPI_BYTES > 2
+  vfdSpiBytes[1] = (data >> 8) & 0xff;
+#endif
+#if VFD_SPI_BYTES > 3
+  vfdSpiBytes[2] = (data >> 16) & 0xff;
+#endif
+  vfdSpiPending = VFD_SPI_BYTES - 1;
+  halSpiWrite(data >> (8 * (VFD_SPI_BYTES - 1)));
+}
+
+
+// SPI Serial Transfer Complete interrupt service routine
+// Streams the lower bytes of the word and then commits the whole word to the VFD
+HAL_ISR(SPI_STC) void spi_isr(void) {
+  profileBegin(PROFILE_ISR_SPI);
+  if (vfdSpiPending) {
+    // A higher byte is done, now shift the next one
+    vfdSpiPending--;
+    halSpiWrite(vfdSpiBytes[vfdSpiPending]);
+  } else {
+    // Whole word is shifted, start displaying the data on VFD 
+    // Set high the PD7 pin -> MAX6920AWP.LOAD signal.
+    // Allowing the serially shifted data to be read into the driver stage
+    pinHigh(PIN_VFD_LOAD);
+
+    // MAX6920AWP needs 55ns for the VFD LOAD pulse being high, 1 instruction @ 8MHz takes 125ns  
+
+    // Set low the PD7 pin -> MAX6920AWP.LOAD signal.
+    // Returning back to original operation mode (shifting data)    
+    pinLow(PIN_VFD_LOAD);
+    vfdSpiBusy = 0;
+
+    if (vfdSpiRelease) {
+      // The blank word of the vfdOff is latched, the SPI is not needed until the next refresh
+      vfdSpiRelease = 0;
+      powerRelease(POWER_SPI);
+    }
+  }
+  profileEnd(PROFILE_ISR_SPI);
+}
+
+
+// Timer0 output compare A interrupt service routine (start of a new slot)
+// Move to the next character, light it up and schedule the end of its on-time
+// A character which changed shows its old or new word, both for the whole on-time, so the
+// even brightness of the slots stays and the fade costs only two table lookups.
+HAL_ISR(TIM0_COMPA) void timer0_compa_isr(void) {
+  vfdWord word;
+  uint8_t fade;
+
+#if PROFILE
+  if (vfdSlotStarted) profileEnd(PROFILE_REFRESH);
+  vfdSlotStarted = 1;
+#endif
+  profileBegin(PROFILE_REFRESH);
+  profileBegin(PROFILE_ISR_SLOT);
+  vfdGrid = (vfdGrid >= (VFD_GRIDS - 1)) ? 0 : vfdGrid + 1;
+  OCR0B   = vfdSchedule[vfdGrid];
+  word    = vfdFrame[vfdGrid];
+  fade    = vfdFade[vfdGrid];
+  if (fade < VFD_FADE_FRAMES) {
+    if (!(vfdFadeBits[fade >> 3] & vfdFadeMasks[fade & 7])) word = vfdFrameOld[vfdGrid];
+    vfdFade[vfdGrid] = fade + 1;
+  }
+  vfdShift(word);
+
+  // Filament PWM, on for the first vfdFilamentOn phases of its period of 8 slots. An odd number of
+  // characters doesn't line up with it, so each character sees the filament in every phase. An even
+  // number would, a phase is skipped at the start of each frame then, the frame moves by an odd
+  // number of phases. The pin follows the phase, a skipped phase can't swallow an edge.
+  vfdFilamentPhase = (vfdFilamentPhase + 1) & (VFD_FILAMENT_STEPS - 1);
+#if !(VFD_GRIDS & 1)
+  if (0 == vfdGrid) vfdFilamentPhase = (vfdFilamentPhase + 1) & (VFD_FILAMENT_STEPS - 1);
+#endif
+  if (vfdFilamentPhase < vfdFilamentOn) fHeatOn();
+  else                                  fHeatOff();
+  profileEnd(PROFILE_ISR_SLOT);
+}
+
+
+// Timer0 output compare B interrupt service routine (the end of the on-time of the slot)
+// Clear the VFD after each character to remove ghosting between characters,
+// forcing each segment to glow equal amount of time and have even brightness
+HAL_ISR(TIM0_COMPB) void timer0_compb_isr(void) {
+  vfdShift(0);
+}
+
+
+// Wait for the blanked part of a slot (its blank word latched, no slot IRQ pending) and freeze the
+// Timer0 there. Returns with the IRQs disabled, the caller can keep them off without any slot edge
+// passing meanwhile, the blanked part just gets longer by as much. Without the refresh nothing
+// is timed by the Timer0 and it returns right away.
+void vfdPause(void) {
+  halInterruptsDisable();
+  while (vfdPower >= VFD_POWER_PREHEAT &&
+         ((TIFR0 & ((1 << OCF0A) | (1 << OCF0B))) || TCNT0 <= OCR0B || vfdSpiBusy)) {
+    halSleepIdle();                                         // Checked with the IRQs disabled, as the schedSleep
+    halInterruptsDisable();
+  }
+  vfdPausedClock = TCCR0B;
+  TCCR0B         = vfdPausedClock & ~((1 << CS02) | (1 << CS01) | (1 << CS00));
+}
+
+
+// Continue the refresh from where the vfdPause froze it and enable the IRQs
+void vfdResume(void) {
+  TCCR0B = vfdPausedClock;
+  halInterruptsEnable();
+}
+
 
+// Calculate the on-times of all characters for a global brightness level,
+// done only when the level changes, the refresh just reads the vfdSchedule
+void vfdSetBrightness(uint8_t level) {
+  uint8_t i;
 
+  if (level >= VFD_BRIGHTNESS_LEVELS) level = VFD_BRIGHTNESS_LEVELS - 1;
+  if (level == vfdLevel) return;
+  vfdLevel = level;
 
-// Turn off VFD's high-voltage DC2DC boost converter (PD1)
-void dc2dcOff(void) {
-  PORTD &= ~(1 << PORTD1);
+  for (i = 0; i < VFD_GRIDS; i++) {
+    uint8_t ticks  = ((((uint16_t)vfdLevels[level] * vfdGridTrim[i]) >> 4) * vfdTrim) >> 4;
+    vfdSchedule[i] = (ticks < VFD_MIN_ON_TICKS) ? VFD_MIN_ON_TICKS : ticks;
+  }
 }
 
 
-// Turn on VFD's high-voltage DC2DC boost converter (PD1) 
-void dc2dcOn(void) {
-  PORTD |= 1 << PORTD1;
+// Drive for the temperature (see thermal.h), the on-times scaled by the `trim` in 1/16ths and the
+// filament's maintenance duty. A preheat in progress applies the duty once it's done.
+void vfdCompensate(uint8_t trim, uint8_t duty) {
+  uint8_t level = vfdLevel;
+
+  vfdFilamentDuty = duty;
+  if (VFD_POWER_ON == vfdPower) vfdFilamentOn = duty;
+  if (trim == vfdTrim) return;
+  vfdTrim = trim;
+  if (255 == level) return;                                 // Nothing calculated yet, the first level uses the trim
+  vfdLevel = 255;
+  vfdSetBrightness(level);
 }
 
 
-// Turn off VFD's low-voltage filament heater (PB1) 
-void fHeatOff(void) {
-  PORTB &= ~(1 << PORTB1);
+// Apply the user's brightness setting, but at night do not go above the VFD_NIGHT_LEVEL
+// and never above what the battery allows
+void vfdBrightnessForHour(uint8_t hour) {
+  uint8_t level = vfdBrightness;
+
+  if (level > vfdLimit) level = vfdLimit;
+
+  if ((hour >= VFD_NIGHT_START || hour < VFD_NIGHT_END) && level > VFD_NIGHT_LEVEL) {
+    level = VFD_NIGHT_LEVEL;
+  }
+  vfdSetBrightness(level);
 }
 
 
-// Turn on VFD's low-voltage filament heater (PB1) 
-void fHeatOn(void) {
-  PORTB |= 1 << PORTB1;
+// The first frame with the time since the vfdOn, how long the person looking at the watch waited
+void vfdFirstFrame(void) {
+  if (!vfdWaiting || vfdPower < VFD_POWER_PREHEAT) return;
+  if (255 == vfdHour && 255 == vfdMinute) return;   // Still blank, the RTC read didn't finish yet
+
+  vfdWaiting     = 0;
+  vfdWakeLatency = schedNow() - vfdPowerAt;
+  if (vfdWakeLatency > vfdWakeLatencyMax) vfdWakeLatencyMax = vfdWakeLatency;
 }
 
 
-// Turn off both DC2DC and filament heater
+// Turn off both DC2DC and filament heater, at any step of the power sequence
 void vfdOff() {
+  uint8_t i;
+
+  TCCR0B = (0<<WGM02) | (0<<CS02) | (0<<CS01) | (0<<CS00); // Stop the refresh
+  for (i = 0; i < VFD_GRIDS; i++) {
+    vfdFrame[i] = 0;                                        // The next wake-up fades in from blank, not from this time
+    vfdFade[i]  = VFD_FADE_FRAMES;
+  }
+  if (vfdPower >= VFD_POWER_PREHEAT) {
+    // The refresh was running, the SPI and the Timer0 have their clocks. A word of the last slot
+    // might still be shifting, a write now would collide with it or latch half of each.
+    while (vfdSpiBusy) delay_us(1);
+    vfdSpiRelease = 1;
+    vfdShift(0);                                            // Leave all segments off for the next wake-up
+    powerRelease(POWER_TIMER0);
+#if PROFILE
+    vfdSlotStarted = 0;                                     // The Timer0 is stopped, its IRQ can't race this
+#endif
+  }
   dc2dcOff();
   fHeatOff();
+  schedCancel(SCHED_VFD_POWER);
+  vfdPower = VFD_POWER_OFF;
 }
 
 
-// Turn on both DC2DC and filament heater
+// Start the power sequence with the filament at the full power, the rest is done by the vfdHandler
+// while the super loop does other things (the RTC read is in flight meanwhile)
 void vfdOn() {
-  dc2dcOn();
   fHeatOn();
-  delay_us(500); // Give time for DC2DC to stabilise before displaying the time 
-}
-
-
-// Turn off all segments
-// Almost duplication of the function below, but it's not implemented
-// in a generic way because the CodeVisionAVR toolchain will not
-// optimize things, even single instruction functions will not get
-// inlined and this section needs to perform quickly
-void clearVfd() {
-  // Send 16-bit of zeros to the MAX6920AWP
-  spi(0);
-  spi(0);
-               
-  // Commit the 'clear screen' 
-  // Set high the PD7 pin -> MAX6920AWP.LOAD signal.
-  // Allowing the serially  shifted data to be read into the driver stage
-  PORTD |= (1 << PORTD7);
-
-  // MAX6920AWP needs 55ns for the VFD LOAD pulse being high, 1 instruction @ 8MHz takes 125ns  
-  
-  // Set low the PD7 pin -> MAX6920AWP.LOAD signal.
-  // Returning back to original operation mode (shifting data)    
-  PORTD &= ~(1 << PORTD7);
-}
-
-
-// Transfer data to VFD, at the time only 1 character will be displayed,
-// to display full clock this call needs to be called 4-5 times
-void sendDataToVfd(uint16_t data) {
-  // Transfer 16-bits to the MAX6920AWP, only lower 12-bits will be kept, 
-  // bit 12-15 will be truncated in the MAX6920AWP chip
-  spi(data >> 8);
-  spi(data & 0xff);
-               
-  // Start displaying the data on VFD 
-  // Set high the PD7 pin -> MAX6920AWP.LOAD signal.
-  // Allowing the serially  shifted data to be read into the driver stage
-  PORTD |= (1 << PORTD7);
-  
-  // MAX6920AWP needs 55ns for the VFD LOAD pulse being high, 1 instruction @ 8MHz takes 125ns
-  
-  // Set low the PD7 pin -> MAX6920AWP.LOAD signal.
-  // Returning back to original operation mode (shifting data)    
-  PORTD &= ~(1 << PORTD7);
-  
-  delay_us(10);  // Displaying a character give it a moment to glow
-                 
-  // Clear the VFD after each character to remove ghosting between characters
-  // and to make sure last character is disabled before going to super loop
-  // forcing each segment to glow equal amount of time and have even brightness
-  clearVfd();      
-}
-
-
-
-// Take `hour` and `minute` values and send the corresponding data
-// to VFD which will display it
+  vfdFilamentOn = VFD_FILAMENT_STEPS;
+  vfdPower      = VFD_POWER_HEAT;
+  vfdPowerAt    = schedNow();
+  vfdWaiting    = 1;
+  schedAfter(SCHED_VFD_POWER, SCHED_US(VFD_HEAT_LEAD_US));
+}
+
+
+// Next step of the power sequence
+void vfdHandler(void) {
+  if (!schedTake(SCHED_VFD_POWER)) return;
+
+  switch (vfdPower) {
+    case VFD_POWER_HEAT:
+      // The filament is warming up, the high voltage can follow
+      dc2dcOn();
+      vfdPower = VFD_POWER_SETTLE;
+      schedAfter(SCHED_VFD_POWER, SCHED_US(VFD_DC2DC_SETTLE_US));
+    break;
+
+    case VFD_POWER_SETTLE:
+      // The DC2DC is stable, start the refresh from the first character, Timer0 clocked at 1MHz (/8 of sysclock)
+      if (255 == vfdLevel) vfdSetBrightness(vfdBrightness); // Powering up, make sure there is a schedule
+      powerAcquire(POWER_TIMER0);
+      powerAcquire(POWER_SPI);
+      vfdFilamentPhase = 0;
+      TCNT0            = 0;
+      vfdGrid          = VFD_GRIDS - 1;
+      TCCR0B           = (0<<WGM02) | (0<<CS02) | (1<<CS01) | (0<<CS00);
+      vfdPower         = VFD_POWER_PREHEAT;
+      schedAfter(SCHED_VFD_POWER, SCHED_MS(VFD_FILAMENT_PREHEAT_MS));
+      vfdFirstFrame();                                      // The time might be known already
+    break;
+
+    case VFD_POWER_PREHEAT:
+      // The filament is hot, continue with the maintenance duty from the next period
+      vfdFilamentOn = vfdFilamentDuty;
+      vfdPower      = VFD_POWER_ON;
+    break;
+  }
+}
+
+
+// Replace the word of a character, with the IRQs disabled. A change starts its cross-fade from
+// the word it had, a character blinking in its off half is blank (and fades out and in too).
+// Until the first frame with the time after the vfdOn there is nothing to fade from, the
+// person is waiting for the digits, so they appear at once.
+static void vfdCommit(uint8_t grid, vfdWord word) {
+  if ((vfdBlink & ((vfdGridMask)1 << grid)) && vfdBlinkOff) word = 0;
+  if (word == vfdFrame[grid]) return;
+  vfdFrameOld[grid] = vfdFrame[grid];
+  vfdFrame[grid]    = word;
+  vfdFade[grid]     = vfdWaiting ? VFD_FADE_FRAMES : 0;
+}
+
+
+// Take `hour` and `minute` values and render the corresponding data
+// into the frame buffer which is displayed by the Timer0 IRQs.
+// The words are taken straight from the flash tables, no divisions needed.
 void displayTime() {
+  vfdWord colon = vfdColon ? VFD_BIT(DISPLAY_CH_COLON) | DISPLAY_COLON_SEGMENTS : 0;
+#if VFD_GRIDS > 5
+  uint8_t i;
+#endif
+
+  profileBegin(PROFILE_DISPLAY);
+
+  // Commit the whole frame at once, so the Timer0 IRQ will not display a half-updated word
+  halInterruptsDisable();
+
+  // Hours, the table has the leading 0 already blank, 255 doesn't display them at all
+  vfdCommit(DISPLAY_POS_HOURS,       (255 == vfdHour) ? 0 : fontHours[vfdHour].major);
+  vfdCommit(DISPLAY_POS_HOURS + 1,   (255 == vfdHour) ? 0 : fontHours[vfdHour].minor);
 
-  //  --A--
-  // |     |
-  // F     B
-  // |     |
-  //  --G--
-  // |     |
-  // E     C
-  // |     |
-  //  --D--
-
-  const uint16_t segments[] = {
-    1 << VFD_A | 1 << VFD_B | 1 << VFD_C | 1 << VFD_D | 1 << VFD_E | 1 << VFD_F,               // 0 character
-    1 << VFD_B | 1 << VFD_C,                                                                   // 1 character
-    1 << VFD_A | 1 << VFD_B | 1 << VFD_G | 1 << VFD_E | 1 << VFD_D,                            // 2 character
-    1 << VFD_A | 1 << VFD_B | 1 << VFD_G | 1 << VFD_C | 1 << VFD_D,                            // 3 character
-    1 << VFD_F | 1 << VFD_G | 1 << VFD_B | 1 << VFD_C,                                         // 4 character
-    1 << VFD_A | 1 << VFD_F | 1 << VFD_G | 1 << VFD_C | 1 << VFD_D,                            // 5 character
-    1 << VFD_F | 1 << VFD_G | 1 << VFD_C | 1 << VFD_D | 1 << VFD_E,                            // 6 character
-    1 << VFD_A | 1 << VFD_B | 1 << VFD_C,                                                      // 7 character
-    1 << VFD_A | 1 << VFD_B | 1 << VFD_C | 1 << VFD_D | 1 << VFD_E | 1 << VFD_F | 1 << VFD_G,  // 8 character
-    1 << VFD_A | 1 << VFD_F | 1 << VFD_B | 1 << VFD_G | 1 << VFD_C,                            // 9 character
-  };                                     
-  
-  // Hours
-  if (255 == vfdHour) {
-    // Do not display hours
-    sendDataToVfd(0);
-    sendDataToVfd(0);
-  } else {     
-    // Regular display of hours
-    uint8_t hourTens = vfdHour / 10;
-    sendDataToVfd((0 == hourTens) ? 0 : segments[hourTens] | 1 << VFD_CH_1); // display blank if it's leading 0    
-    sendDataToVfd(segments[vfdHour % 10]                   | 1 << VFD_CH_2);             
-  }                                        
-                    
   // The ':' dots
-  sendDataToVfd(0                                          | (systick >= (SYSTICK_MAX/2))  << VFD_CH_3);
-         
+  vfdCommit(DISPLAY_POS_COLON, colon);
+
   // Minutes
-  if (255 == vfdMinute) {
-    // Do not display minutes
-    sendDataToVfd(0);
-    sendDataToVfd(0);
-  } else {
-    // Regular display of minutes
-    sendDataToVfd(segments[(vfdMinute / 10) % 60]          | 1 << VFD_CH_4);    
-    sendDataToVfd(segments[vfdMinute % 10]                 | 1 << VFD_CH_5);    
+  vfdCommit(DISPLAY_POS_MINUTES,     (255 == vfdMinute) ? 0 : fontMinutes[vfdMinute].major);
+  vfdCommit(DISPLAY_POS_MINUTES + 1, (255 == vfdMinute) ? 0 : fontMinutes[vfdMinute].minor);
+
+#if VFD_GRIDS > 5
+  // The grids of a longer tube which the time doesn't use (a text might have left something there)
+  for (i = 0; i < VFD_GRIDS; i++) {
+    if (i == DISPLAY_POS_HOURS   || i == DISPLAY_POS_HOURS + 1   || i == DISPLAY_POS_COLON ||
+        i == DISPLAY_POS_MINUTES || i == DISPLAY_POS_MINUTES + 1) continue;
+    vfdCommit(i, 0);
   }
+#endif
+
+  halInterruptsEnable();
+  vfdFirstFrame();
+  profileEnd(PROFILE_DISPLAY);
 }
 
+
+// Render the first VFD_TEXT_CHARS characters of the `text` into the frame buffer (the ':' stays off),
+// a shorter text is padded with blank characters
+void displayText(char *text) {
+  vfdWord frame[VFD_TEXT_CHARS];
+  uint8_t i, character;
+
+  for (i = 0; i < VFD_TEXT_CHARS; i++) {
+    frame[i] = (*text) ? fontGlyph(*text++) : 0;
+  }
+
+  halInterruptsDisable();
+  for (i = 0; i < VFD_GRIDS; i++) {
+    character = vfdGridText[i];
+    vfdCommit(i, (DISPLAY_NO_TEXT == character) ? 0 : frame[character] | vfdGridWord[i]);
+  }
+  halInterruptsEnable();
+}
@@ -3,48 +3,146 @@
 
 #include <stdint.h>     // `uint8_t` and `uint16_t` 
 
+#include "display.h"
+
 extern uint8_t vfdHour;
 extern uint8_t vfdMinute;
+extern uint8_t vfdColon;
+
+
+
+// The tube, its wiring and the driver are described in the display.h, the words sent to the driver
+// have just enough bits for it and each of them takes VFD_SPI_BYTES bytes on the SPI
+#define VFD_GRIDS        DISPLAY_GRIDS
+#define VFD_TEXT_CHARS   DISPLAY_TEXT_CHARS
+#define VFD_SPI_BYTES    ((DISPLAY_DRIVER_BITS + 7) / 8)
+
+#if DISPLAY_DRIVER_BITS > 16
+typedef uint32_t vfdWord;
+#define VFD_BIT(n)       (1UL << (n))
+#else
+typedef uint16_t vfdWord;
+#define VFD_BIT(n)       (1U << (n))
+#endif
+
+// One bit for each grid (the blinking characters)
+#if VFD_GRIDS > 8
+typedef uint16_t vfdGridMask;
+#else
+typedef uint8_t  vfdGridMask;
+#endif
+
+#if VFD_GRIDS > 16
+#error "At most 16 grids, see the vfdGridMask"
+#endif
+
+
+// Multiplexing of the characters is driven by the Timer0 (1us ticks) in the background,
+// each character (grid) gets its own slot and glows only for a part of it (its on-time),
+// the rest of the slot is blanked. The on-times come from the vfdSchedule. The frame keeps
+// its length for any number of grids, a tube with more of them gets shorter slots instead.
+#define VFD_FRAME_TICKS  1250                          // 1.25ms for the whole frame (800Hz refresh)
+#define VFD_SLOT_TICKS   (VFD_FRAME_TICKS / VFD_GRIDS) // 250 * 1us = 250us per character of the IVL2-7/5
+#define VFD_MIN_ON_TICKS (2 + 5 * VFD_SPI_BYTES)       // Shifting 16-bits to the MAX6920AWP takes ~10us (~5us a byte), shorter on-time would blank it too soon
 
+// Global brightness levels as on-times of a character in 1us ticks, less glowing means less load on the DC2DC.
+// Given for the 250us slot of the 5 grids and their 12us minimum. Another tube rescales them between its
+// own VFD_MIN_ON_TICKS and the same share of its slot as the 150us, a shorter slot would push the dim
+// levels below the minimum of a wider driver and the clamp would make them all the same.
+// The busy-waiting refresh before the Timer0 lit each character for its 10us delay and the ~10us of
+// shifting the blank word, then the next one after ~15us of shifting its word and the loop around it,
+// about 11% of the time for each of the 5 characters. The default is the nearest level to that, the
+// watch keeps the brightness it always had until the person picks another level.
+#define VFD_LEVEL_MAX_TICKS    ((150 * VFD_SLOT_TICKS) / 250)
+#define VFD_LEVEL_SCALE(ticks) (VFD_MIN_ON_TICKS + ((ticks) - 12) * (VFD_LEVEL_MAX_TICKS - VFD_MIN_ON_TICKS) / (150 - 12))
+#define VFD_BRIGHTNESS_LEVELS  6
+#define VFD_LEVEL_0            VFD_MIN_ON_TICKS
+#define VFD_LEVEL_1            VFD_LEVEL_SCALE(20)
+#define VFD_LEVEL_2            VFD_LEVEL_SCALE(35)
+#define VFD_LEVEL_3            VFD_LEVEL_SCALE(50)
+#define VFD_LEVEL_4            VFD_LEVEL_SCALE(80)
+#define VFD_LEVEL_5            VFD_LEVEL_MAX_TICKS
+#define VFD_BRIGHTNESS_DEFAULT 5   // 12% of the frame (150us of the 5 grids), the nearest level to the old refresh
 
-#define SLEEP_TIMEOUT 240  // 240 * 0.05s = 12s timeout before turning off the VFD
+#if !(VFD_LEVEL_0 >= VFD_MIN_ON_TICKS && VFD_LEVEL_1 > VFD_LEVEL_0 && VFD_LEVEL_2 > VFD_LEVEL_1 && \
+      VFD_LEVEL_3 > VFD_LEVEL_2 && VFD_LEVEL_4 > VFD_LEVEL_3 && VFD_LEVEL_5 > VFD_LEVEL_4)
+#error "The brightness levels have to be at least the VFD_MIN_ON_TICKS and each brighter than the previous one"
+#endif
+
+#if VFD_SLOT_TICKS > 256
+#error "The slot is one period of the 8-bit Timer0 in the CTC mode"
+#endif
+
+#if VFD_LEVEL_5 >= VFD_SLOT_TICKS
+#error "The brightest level has to be shorter than the VFD_SLOT_TICKS, otherwise there will be no blanking"
+#endif
+
+// Power sequence of the vfdOn, each step is a SCHED_VFD_POWER deadline so nothing busy-waits:
+// the filament starts heating first, then the DC2DC, and the refresh starts once the DC2DC settled
+#define VFD_POWER_OFF           0
+#define VFD_POWER_HEAT          1  // Only the filament, at the full power
+#define VFD_POWER_SETTLE        2  // The DC2DC is starting up
+#define VFD_POWER_PREHEAT       3  // Refreshing, the filament still at the full power
+#define VFD_POWER_ON            4  // Refreshing, the filament at the maintenance duty
 
+#define VFD_HEAT_LEAD_US        1000 // Filament alone before the high voltage is applied
+#define VFD_DC2DC_SETTLE_US     500  // DC2DC start-up before displaying anything
 
-// Character selectors
-#define VFD_CH_1 6      // Hours major
-#define VFD_CH_2 5      // Hours minor
-#define VFD_CH_3 3      // The : character between the hours and minutes -> HH:MM
-#define VFD_CH_4 1      // Minutes major
-#define VFD_CH_5 11     // Minutes minor
+// The filament is switched by the Timer0 slots, on for the first vfdFilamentDuty of every
+// VFD_FILAMENT_STEPS slots (2ms period). The wire's thermal time constant is far longer, so it
+// glows as with DC, but consumes only duty/steps of the power. After the vfdOn it's heated
+// with the full power until the VFD_FILAMENT_PREHEAT_MS after the refresh started, a cold filament emits no electrons.
+#define VFD_FILAMENT_STEPS      8
+#define VFD_FILAMENT_DUTY       5    // Maintenance duty, 5/8 of the DC power
+#define VFD_FILAMENT_PREHEAT_MS 300
 
-// Individual segments of a 7-segment character 
-// https://en.wikipedia.org/wiki/Seven-segment_display
-//  --A--
-// |     |
-// F     B
-// |     |
-//  --G--
-// |     |
-// E     C
-// |     |
-//  --D--
+#if VFD_FILAMENT_STEPS & (VFD_FILAMENT_STEPS - 1)
+#error "The VFD_FILAMENT_STEPS must be a power of 2"
+#endif
+
+#if VFD_FILAMENT_DUTY > VFD_FILAMENT_STEPS
+#error "The VFD_FILAMENT_DUTY can't be longer than the whole period"
+#endif
+
+// A character which changes cross-fades from its old word to the new one over the VFD_FADE_FRAMES
+// (160ms), by showing one or the other in each frame. The blinking characters (set by the vfdBlink)
+// go blank while the vfdBlinkOff is set, through the same fade.
+#define VFD_FADE_FRAMES        128
+#define VFD_BLINK_HOURS        (3 << DISPLAY_POS_HOURS)    // Bits of the characters in the vfdFrame
+#define VFD_BLINK_MINUTES      (3 << DISPLAY_POS_MINUTES)
+
+#if VFD_FADE_FRAMES != 128
+#error "The vfdFadeBits table has 8 steps of 16 frames"
+#endif
 
-#define VFD_A 10
-#define VFD_B 0
-#define VFD_C 4
-#define VFD_D 2
-#define VFD_E 8
-#define VFD_F 9
-#define VFD_G 7
+// Night mode, between these hours the brightness is limited to the VFD_NIGHT_LEVEL
+#define VFD_NIGHT_START        22  // From 22:00
+#define VFD_NIGHT_END          7   // until 6:59
+#define VFD_NIGHT_LEVEL        1
 
 
-extern volatile uint8_t stayAwake;              // How long before going to sleep (20Hz counter counting to 0)
+extern volatile vfdWord  vfdFrame[VFD_GRIDS];   // What is displayed, one driver word for each character
+extern          uint8_t  vfdSchedule[VFD_GRIDS];// On-time of each character in 1us ticks
+extern          uint8_t  vfdBrightness;         // User setting 0 to VFD_BRIGHTNESS_LEVELS-1
+extern          uint8_t  vfdFilamentDuty;       // Maintenance duty 0 to VFD_FILAMENT_STEPS (DC), applied after the preheat
+extern          uint8_t  vfdPower;              // VFD_POWER_OFF..VFD_POWER_ON
+extern          uint16_t vfdWakeLatency;        // vfdOn to the first frame with the time (128us ticks), the last one
+extern          uint16_t vfdWakeLatencyMax;     // and the worst one
+extern          uint8_t  vfdLimit;              // Highest level allowed (by the battery), applied by the vfdBrightnessForHour
+extern          vfdGridMask vfdBlink;             // VFD_BLINK_* characters blanked while the vfdBlinkOff, 0 = nothing blinks
+extern          bit      vfdBlinkOff;
 
 
-void vfdOn(void);                               // Turn on both DC2DC and filament heater
-void vfdOff(void);                              // Turn off both DC2DC and filament heater
-void sendDataToVfd(uint16_t data);              // Transfer 1 character to VFD
-void displayTime(); // Display HH:MM on the VFD
+void vfdOn(void);                               // Start the power sequence of the filament, DC2DC and the refresh
+void vfdOff(void);                              // Stop the refresh and turn off both DC2DC and filament heater
+void displayTime(); // Render HH:MM into the frame buffer
+void displayText(char *text);                   // Render VFD_TEXT_CHARS alphanumerical characters into the frame buffer
+void vfdSetBrightness(uint8_t level);           // Calculate the vfdSchedule for a global brightness level
+void vfdBrightnessForHour(uint8_t hour);        // Apply the vfdBrightness, limited by the night mode
+void vfdCompensate(uint8_t trim, uint8_t duty);  // Temperature compensation of the on-times (1/16ths) and the filament's duty
+void vfdHandler(void);                          // Called from the super loop, steps the power sequence on the SCHED_VFD_POWER
+void vfdPause(void);                            // Disable the IRQs and freeze the refresh in the blanked part of a slot
+void vfdResume(void);                           // Let the refresh continue and enable the IRQs
 
 
 #endif